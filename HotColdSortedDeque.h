@@ -0,0 +1,276 @@
+/*
+ * HotColdSortedDeque.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_HOTCOLDSORTEDDEQUE_H_
+#define UTILS_HOTCOLDSORTEDDEQUE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "IntrusiveSortedDeque.h"
+
+namespace Utils {
+
+// SlabPool: Holds objects in slots allocated in slabs of SLAB_SIZE, which are never moved, so that an object is
+// addressed by its slot number for as long as it lives. Freed slots are reused in LIFO order.
+// The pool does not track which slots are in use: Its owner must free all the slots it allocated before destroying it.
+
+template <typename T, std::size_t SLAB_SIZE = 256>
+class SlabPool {
+public:
+	typedef std::uint32_t slot_type;
+	static constexpr slot_type INVALID_SLOT = std::numeric_limits<slot_type>::max();
+
+	SlabPool() = default;
+	SlabPool(const SlabPool&) = delete;
+	SlabPool& operator=(const SlabPool&) = delete;
+
+	~SlabPool()
+	{
+		assert(m_freeSlots.size() == m_slabs.size() * SLAB_SIZE);
+	}
+
+	template< typename... Args >
+	slot_type allocate(Args&&... args)
+	{
+		if (m_freeSlots.empty()) {
+			AddSlab();
+		}
+
+		const slot_type slot = m_freeSlots.back();
+		new (Address(slot)) T(std::forward<Args>(args)...);
+		m_freeSlots.pop_back();
+		return slot;
+	}
+
+	void free(slot_type slot)
+	{
+		(*this)[slot].~T();
+		m_freeSlots.push_back(slot);
+	}
+
+	T& operator[](slot_type slot)
+	{
+		return *reinterpret_cast<T*>(Address(slot));
+	}
+
+	const T& operator[](slot_type slot) const
+	{
+		return *reinterpret_cast<const T*>(Address(slot));
+	}
+
+private:
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+	std::vector<std::unique_ptr<Storage[]>> m_slabs;
+	std::vector<slot_type> m_freeSlots;
+
+	void* Address(slot_type slot) const
+	{
+		return & m_slabs[slot / SLAB_SIZE][slot % SLAB_SIZE];
+	}
+
+	void AddSlab()
+	{
+		const slot_type first = static_cast<slot_type>(m_slabs.size() * SLAB_SIZE);
+		m_slabs.emplace_back(new Storage[SLAB_SIZE]);
+
+		// Push in reverse, so that the slots of the new slab are handed out in ascending order
+		for (std::size_t i = SLAB_SIZE; i > 0; --i) {
+			m_freeSlots.push_back(first + static_cast<slot_type>(i - 1));
+		}
+	}
+};
+
+// HotColdSortedDeque: Splits each value into a hot part, which is its key, and a cold payload, which is only accessed
+// after a successful lookup. The keys are held in an InstrusiveSortedDeque of compact entries, each also holding the
+// slot of its payload in a SlabPool, with an invalid slot marking a deleted entry. Hence searches, trims and skipping of
+// deleted values touch only the entries, which are typically several times smaller than the complete values.
+// The payload of a value is destroyed as soon as it is removed, while its entry may remain until it's trimmed.
+// The SearchIndex, SearchPolicy and Compare template arguments are passed on to the InstrusiveSortedDeque.
+
+template <typename Key, typename Payload, typename SearchIndex = NoSearchIndex, typename SearchPolicy = BinarySearchPolicy,
+		  typename Compare = std::less<Key>>
+class HotColdSortedDeque {
+	typedef SlabPool<Payload> PayloadPool;
+	typedef typename PayloadPool::slot_type slot_type;
+
+public:
+	// The entries of the hot deque, satisfying the requirements of InstrusiveSortedDeque on its values
+	class entry_type {
+	public:
+		typedef Key KeyType;
+
+		entry_type() = default;
+
+		entry_type(const KeyType& k, slot_type slot)
+			: m_key(k)
+			, m_slot(slot)
+		{
+		}
+
+		const KeyType& GetKey() const { return m_key; }
+		bool IsDeleted() const { return PayloadPool::INVALID_SLOT == m_slot; }
+		void Remove() { m_slot = PayloadPool::INVALID_SLOT; }
+		slot_type slot() const { return m_slot; }
+
+	private:
+		KeyType m_key = KeyType();
+		slot_type m_slot = PayloadPool::INVALID_SLOT;
+	};
+
+	typedef Key key_type;
+	typedef Payload payload_type;
+	typedef InstrusiveSortedDeque<entry_type, std::allocator<entry_type>, SearchIndex, SearchPolicy, Compare> hot_deque_type;
+	typedef typename hot_deque_type::size_type size_type;
+
+	HotColdSortedDeque() = default;
+	HotColdSortedDeque(const HotColdSortedDeque&) = delete;
+	HotColdSortedDeque& operator=(const HotColdSortedDeque&) = delete;
+
+	~HotColdSortedDeque()
+	{
+		clear();
+	}
+
+	// Append a value with key k, constructing its payload from args. As with InstrusiveSortedDeque::emplace_back(),
+	// a key which is not greater than the last one is inserted at its correct position.
+	template< typename... Args >
+	payload_type& emplace_back(const key_type& k, Args&&... args)
+	{
+		const slot_type slot = m_payloads.allocate(std::forward<Args>(args)...);
+		m_hot.emplace_back(k, slot);
+		return m_payloads[slot];
+	}
+
+	template< typename... Args >
+	payload_type& emplace_front(const key_type& k, Args&&... args)
+	{
+		const slot_type slot = m_payloads.allocate(std::forward<Args>(args)...);
+		m_hot.emplace_front(k, slot);
+		return m_payloads[slot];
+	}
+
+	// Returns the payload of the value with key k, or nullptr if there is no such value
+	payload_type* find(const key_type& k)
+	{
+		const auto it = m_hot.find(k);
+		return (it == m_hot.end()) ? nullptr : & m_payloads[it->slot()];
+	}
+
+	const payload_type* find(const key_type& k) const
+	{
+		const auto it = m_hot.find(k);
+		return (it == m_hot.end()) ? nullptr : & m_payloads[it->slot()];
+	}
+
+	bool erase(const key_type& k)
+	{
+		auto it = m_hot.find(k);
+		if (it == m_hot.end()) {
+			return false;
+		}
+
+		m_payloads.free(it->slot());
+		m_hot.erase(it);
+		return true;
+	}
+
+	void pop_front()
+	{
+		m_payloads.free(m_hot.front().slot());
+		m_hot.pop_front();
+	}
+
+	void pop_back()
+	{
+		m_payloads.free(m_hot.back().slot());
+		m_hot.pop_back();
+	}
+
+	void clear()
+	{
+		if (! m_hot.empty()) {
+			for (const entry_type& entry : m_hot) {
+				m_payloads.free(entry.slot());
+			}
+		}
+
+		m_hot.clear();
+	}
+
+	size_type size() const
+	{
+		return m_hot.size();
+	}
+
+	bool empty() const
+	{
+		return m_hot.empty();
+	}
+
+	const key_type& front_key() const
+	{
+		return m_hot.front().GetKey();
+	}
+
+	const key_type& back_key() const
+	{
+		return m_hot.back().GetKey();
+	}
+
+	// Invoke func(key, payload) on all the values in the order of their keys
+	template <typename Func>
+	void for_each(Func&& func)
+	{
+		for (const entry_type& entry : m_hot) {
+			func(entry.GetKey(), m_payloads[entry.slot()]);
+		}
+	}
+
+	template <typename Func>
+	void for_each(Func&& func) const
+	{
+		for (const entry_type& entry : m_hot) {
+			func(entry.GetKey(), m_payloads[entry.slot()]);
+		}
+	}
+
+	// Access to the hot entries, for the searches which InstrusiveSortedDeque supplies, and to their payloads
+	const hot_deque_type& hot() const
+	{
+		return m_hot;
+	}
+
+	payload_type& payload(const entry_type& entry)
+	{
+		assert(! entry.IsDeleted());
+		return m_payloads[entry.slot()];
+	}
+
+	const payload_type& payload(const entry_type& entry) const
+	{
+		assert(! entry.IsDeleted());
+		return m_payloads[entry.slot()];
+	}
+
+private:
+	// The pool is declared first, so that it's destroyed after the entries referring to it have been cleared
+	PayloadPool m_payloads;
+	hot_deque_type m_hot;
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_HOTCOLDSORTEDDEQUE_H_ */
@@ -9,9 +9,18 @@
 #define UTILS_INTRUSIVESORTEDDEQUE_H_
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
 #include <deque>
+#include <memory>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 
 #include <boost/iterator/filter_iterator.hpp>
+#include <boost/iterator/iterator_facade.hpp>
 
 namespace Utils {
 
@@ -20,21 +29,395 @@ namespace Utils {
 // * KeyType GetKey() const;
 // * IsDeleted() const; - indicating that a value should be considered as removed
 // * Remove()		    - Designates a value as deleted.
+// The first two are only required by the default KeyOf extractor, IntrusiveKeyOf, and the last two only by the default
+// Tombstones policy, IntrusiveTombstones (see below). Other key extractors and tombstones policies allow holding values
+// of arbitrary types, such as third-party structs or plain integers. For the latter, see SortedValueDeque.
+// The allocator used by the underlying deque may be customized using the Allocator template argument.
+// An auxiliary search index may be maintained alongside the values using the SearchIndex template argument,
+// and the search algorithm may be selected using the SearchPolicy template argument (see below).
+// The deleted values may be tracked by the container instead of by the values using the Tombstones template argument.
+// Deleted values in the middle may be removed by compact(), which the Compaction template argument may also trigger,
+// and the operations may be counted by the Stats template argument. See SortedDequePolicies.h for alternatives to
+// the default policies, and for selecting any of the policies by name using PolicySortedDeque.
+// The values are ordered by Compare applied to their keys, which is ascending by default, using std::less of the key
+// type defined by KeyOf, so that the default also applies to values which don't define KeyType. If Compare is transparent,
+// that is, it defines is_transparent, the searches also accept any type which Compare can compare with the keys,
+// such as a prefix of the key or a cheaper proxy for it. Such searches do not consult the search index.
+
+// NoSearchIndex: The default search index, which does nothing.
+// A search index is notified after each change in the positions of the values, through a view of their keys,
+// and is consulted by searches for narrowing the range of positions to be searched. It must supply the following methods:
+// * void OnPushBack(const Keys& keys);			- A value was appended at the back
+// * void OnPushFront(const Keys& keys);		- A value was prepended at the front
+// * void OnPopFront(const Keys& keys, n);		- n values were removed from the front
+// * void OnPopBack(const Keys& keys, n);		- n values were removed from the back
+// * void OnReset(const Keys& keys);			- The values may have been rearranged arbitrarily
+// * bool Narrow(const Keys& keys, k, lo, hi) const;	- Narrows the range of positions [lo, hi) which contains the
+//												  lower bound of k, in the order of the container's Compare.
+//												  Returns false if the range could not be narrowed.
+// * SearchIndexLookup Lookup(const Keys& keys, k, pos) const;	- Looks up the exact position of k, for indexes which
+//												  can tell whether a key is present without a search.
+// Marking values as deleted does not affect the index, since deleted values retain their keys and positions.
+
+enum SearchIndexLookup {
+	SEARCH_INDEX_UNKNOWN,					// The index cannot tell whether the key is present
+	SEARCH_INDEX_ABSENT,					// The key is not present
+	SEARCH_INDEX_FOUND						// The key is present at the returned position
+};
+
+struct NoSearchIndex {
+	template <typename Keys> void OnPushBack(const Keys&) {}
+	template <typename Keys> void OnPushFront(const Keys&) {}
+	template <typename Keys, typename SizeType> void OnPopFront(const Keys&, SizeType) {}
+	template <typename Keys, typename SizeType> void OnPopBack(const Keys&, SizeType) {}
+	template <typename Keys> void OnReset(const Keys&) {}
+
+	template <typename Keys, typename KeyType, typename SizeType>
+	constexpr bool Narrow(const Keys&, const KeyType&, SizeType&, SizeType&) const { return false; }
+
+	template <typename Keys, typename KeyType, typename SizeType>
+	constexpr SearchIndexLookup Lookup(const Keys&, const KeyType&, SizeType&) const { return SEARCH_INDEX_UNKNOWN; }
+};
+
+// BinarySearchPolicy: The default search policy, which uses a plain binary search.
+// A search policy supplies the algorithm for finding the lower bound of a key within a range of positions:
+// * static Iter LowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp);
+// where keyOf(value) returns the key of a value, and comp(key, k) tells whether a key is ordered before k.
+// KeyType may differ from the type of the keys if comp is transparent.
+
+struct BinarySearchPolicy {
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter LowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		return std::lower_bound(first, last, k, [keyOf, comp](const typename std::iterator_traits<Iter>::value_type& value, const KeyType& k)->bool {
+			return comp(keyOf(value), k);
+		});
+	}
+};
+
+// EdgeGallopingSearchPolicy: An exponential search, which probes positions at increasing powers of 2 from both edges
+// of the range in turn, and then performs a binary search between the last two probes on the side where the key was passed.
+// Hence its cost is logarithmic in the distance of the key from the nearer edge, which suits lookups that mostly hit
+// values near the front or the back, at the cost of up to twice the probes of a binary search for keys in the middle.
+
+struct EdgeGallopingSearchPolicy {
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter LowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		return Gallop<true, true>(first, last, k, keyOf, comp);
+	}
+
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter LowerBoundFromFront(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		return Gallop<true, false>(first, last, k, keyOf, comp);
+	}
+
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter LowerBoundFromBack(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		return Gallop<false, true>(first, last, k, keyOf, comp);
+	}
+
+	template <bool FROM_FRONT, bool FROM_BACK, typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static Iter Gallop(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		typedef typename std::iterator_traits<Iter>::difference_type Distance;
+
+		// The lower bound is in [lo, hi]
+		const Distance n = last - first;
+		Distance lo = 0;
+		Distance hi = n;
+		for (Distance bound = 1; lo < hi; bound *= 2) {
+			if (FROM_FRONT) {
+				const Distance probe = bound - 1;
+				if (probe >= hi) {
+					break;
+				}
+
+				if (! comp(keyOf(first[probe]), k)) {
+					hi = probe;
+					break;
+				}
+
+				lo = probe + 1;
+			}
+
+			if (FROM_BACK) {
+				const Distance probe = n - bound;
+				if (probe < lo) {
+					break;
+				}
+
+				if (comp(keyOf(first[probe]), k)) {
+					lo = probe + 1;
+					break;
+				}
+
+				hi = probe;
+			}
+		}
+
+		return BinarySearchPolicy::LowerBound(first + lo, first + hi, k, keyOf, comp);
+	}
+};
+
+// IntrusiveTombstones: The default tombstones policy, which relies on the values' own IsDeleted() and Remove() methods.
+// A tombstones policy tracks which of the values in the underlying deque are deleted, by their positions.
+// It is notified of changes in the positions of the values, like a search index, and must supply the following methods:
+// * bool IsDeleted(const T& value, pos) const;		- Whether the value at position pos is deleted
+// * void Remove(T& value, pos);					- Marks the value at position pos as deleted
+// * static bool IsDeletedValue(const T& value);	- Whether a value which isn't held by the container is deleted
+// * Iter SkipForward(Iter it, Iter end, pos&) const;	- The first non-deleted value at or after it, which is at pos, or end.
+//													  pos is advanced to the position of the result.
+// * Iter SkipBackward(Iter it, pos&) const;		- The last non-deleted value at or before it, which must exist
+// * uint64_t LiveMask(const T* values, pos, n) const;	- A mask of the non-deleted values among the n <= 64
+//													  contiguous values starting at pos, with bit i for values[i]
+// * size_type CountDeleted(Iter it, pos, n) const;	- The number of deleted values among the n values starting at it
+// * void OnPushBack(size);, void OnPushFront(size);	- A value was appended or prepended, and the deque has the given size
+// * void OnPopFront(size, n);, void OnPopBack(size, n);	- n values were removed from the front or the back
+// * void OnInsert(size, pos);						- A value was inserted at pos, shifting the following values
+// * void OnReset(size);							- The deque was refilled, with no deleted values
+// Since the positions of the values are only computed for the policy's use, this policy incurs no overhead for them.
+
+struct IntrusiveTombstones {
+	template <typename T, typename SizeType>
+	static bool IsDeleted(const T& value, SizeType) { return value.IsDeleted(); }
+
+	template <typename T, typename SizeType>
+	static void Remove(T& value, SizeType)
+	{
+		value.Remove();
+		assert(value.IsDeleted());
+	}
+
+	template <typename T>
+	static bool IsDeletedValue(const T& value) { return value.IsDeleted(); }
+
+	template <typename Iter, typename SizeType>
+	static Iter SkipForward(Iter it, Iter end, SizeType& pos)
+	{
+		while ((it != end) && it->IsDeleted()) {
+			++it;
+			++pos;
+		}
+
+		return it;
+	}
+
+	template <typename Iter, typename SizeType>
+	static Iter SkipBackward(Iter it, SizeType& pos)
+	{
+		while (it->IsDeleted()) {
+			--it;
+			--pos;
+		}
+
+		return it;
+	}
+
+	template <typename Iter, typename SizeType>
+	static SizeType CountDeleted(Iter it, SizeType, SizeType n)
+	{
+		SizeType count = 0;
+		for (; n > 0; --n, ++it) {
+			count += it->IsDeleted();
+		}
 
-template <typename T>	// TODO: Add other template args allowing the allocator to be customized
-class InstrusiveSortedDeque : public std::deque<T> {
+		return count;
+	}
+
+	// Branch-free, so that the compiler may vectorize it
+	template <typename T, typename SizeType>
+	static std::uint64_t LiveMask(const T* values, SizeType, SizeType n)
+	{
+		std::uint64_t mask = 0;
+		for (SizeType i = 0; i < n; ++i) {
+			mask |= std::uint64_t(! values[i].IsDeleted()) << i;
+		}
+
+		return mask;
+	}
+
+	template <typename SizeType> void OnPushBack(SizeType) {}
+	template <typename SizeType> void OnPushFront(SizeType) {}
+	template <typename SizeType> void OnPopFront(SizeType, SizeType) {}
+	template <typename SizeType> void OnPopBack(SizeType, SizeType) {}
+	template <typename SizeType> void OnInsert(SizeType, SizeType) {}
+	template <typename SizeType> void OnReset(SizeType) {}
+};
+
+// IntrusiveKeyOf: The default key extractor, which relies on the values' own KeyType and GetKey().
+// A key extractor is a stateless function object returning the key of a value, which must also define the type of
+// the keys of the values of type T as key_type<T>. Since it's stateless, calling it costs no more than calling GetKey().
+
+struct IntrusiveKeyOf {
+	template <typename T>
+	using key_type = typename T::KeyType;
+
+	template <typename T>
+	decltype(auto) operator()(const T& value) const
+	{
+		return value.GetKey();
+	}
+};
+
+// IdentityKeyOf: A key extractor for values which are their own keys, such as plain integers.
+// This and MemberKeyOf also give mutable access to the key, for policies which keep state in it (see PackedKeyTombstones).
+struct IdentityKeyOf {
+	template <typename T>
+	using key_type = T;
+
+	template <typename T>
+	const T& operator()(const T& value) const
+	{
+		return value;
+	}
+
+	template <typename T>
+	T& operator()(T& value) const
+	{
+		return value;
+	}
+};
+
+// MemberKeyOf: A key extractor for values whose key is the data member MEMBER of type Key
+template <typename Class, typename Key, Key Class::*MEMBER>
+struct MemberKeyOf {
+	template <typename T>
+	using key_type = Key;
+
+	const Key& operator()(const Class& value) const
+	{
+		return value.*MEMBER;
+	}
+
+	Key& operator()(Class& value) const
+	{
+		return value.*MEMBER;
+	}
+};
+
+// NoCompaction: The default compaction policy, which never triggers compaction.
+// A compaction policy is consulted after values are removed, and must supply the following method:
+// * bool ShouldCompact(size_type capacity, size_type nDeleted) const;	- Whether the deleted values should be removed
+//													  from the underlying deque, given its size and their number
+
+struct NoCompaction {
+	template <typename SizeType>
+	constexpr bool ShouldCompact(SizeType, SizeType) const { return false; }
+};
+
+// NoStats: The default statistics policy, which counts nothing.
+// A statistics policy is notified of the following operations:
+// * void OnFind(bool found);						- A search by key, which found the key or not
+// * void OnErase(size_type n);						- n values were removed, by erase() or by popping them
+// * void OnTrim(size_type n);						- n deleted values were removed from the front or back
+// * void OnCompact(size_type n);					- n deleted values were removed by compaction
+
+struct NoStats {
+	void OnFind(bool) {}
+	template <typename SizeType> void OnErase(SizeType) {}
+	template <typename SizeType> void OnTrim(SizeType) {}
+	template <typename SizeType> void OnCompact(SizeType) {}
+};
+
+// DefaultKeyCompare: Stands for the default Compare, which is std::less of the key type defined by KeyOf.
+// It's resolved by the container, since KeyOf follows Compare in its template arguments.
+
+struct DefaultKeyCompare {};
+
+template <typename T, typename Allocator = std::allocator<T>, typename SearchIndex = NoSearchIndex, typename SearchPolicy = BinarySearchPolicy,
+		  typename CompareArg = DefaultKeyCompare, typename Tombstones = IntrusiveTombstones, typename KeyOf = IntrusiveKeyOf,
+		  typename Compaction = NoCompaction, typename Stats = NoStats>
+class InstrusiveSortedDeque : public std::deque<T, Allocator> {
 private:
 
-	typedef std::deque<T> StdDeque;
+	typedef std::deque<T, Allocator> StdDeque;
+
+	// A default-constructible predicate for filtering out deleted values which aren't held by the container
+	struct DetachedValueFilter {
+		inline bool operator() (const T& value) const
+		{
+			return ! Tombstones::IsDeletedValue(value);
+		}
+	};
+
+	// An iterator over the non-deleted values, which skips the deleted ones using the tombstones policy.
+	// It wraps an iterator of the underlying deque, so like it, it remains valid when other values are removed from
+	// the front. The position in the deque, which the tombstones policy may need for skipping, is computed from it
+	// only while there are deleted values. It's bidirectional only, since moving it by n values takes linear time
+	// whenever there are deleted values in between, and so does std::distance(). count_live() is the faster way
+	// of counting the values in a range.
+	template <typename ContainerPtr, typename BaseIter, typename Value>
+	class live_iterator : public boost::iterator_facade<live_iterator<ContainerPtr, BaseIter, Value>, Value, std::bidirectional_iterator_tag> {
+	public:
+		live_iterator()
+			: m_container(nullptr)
+		{
+		}
 
-	static constexpr bool FilterPredicate(const T& value) { return ! value.IsDeleted(); }
+		// Conversion from a non-const iterator to a const one
+		template <typename OtherPtr, typename OtherIter, typename OtherValue,
+				  typename = typename std::enable_if<std::is_convertible<OtherIter, BaseIter>::value>::type>
+		live_iterator(const live_iterator<OtherPtr, OtherIter, OtherValue>& other)
+			: m_container(other.m_container)
+			, m_it(other.m_it)
+		{
+		}
 
+		// The iterator of the underlying deque
+		const BaseIter& base() const
+		{
+			return m_it;
+		}
 
-	// A default-constructible type which wraps FilterPredicate
-	struct FilterPredicateType {
-		inline bool operator() (const T& value)
+		// The position in the underlying deque
+		typename StdDeque::size_type position() const
 		{
-			return FilterPredicate(value);
+			return m_it - m_container->StdDeque::begin();
+		}
+
+	private:
+		friend class boost::iterator_core_access;
+		friend class InstrusiveSortedDeque;
+		template <typename, typename, typename> friend class live_iterator;
+
+		ContainerPtr m_container;
+		BaseIter m_it;
+
+		// it should refer to a non-deleted value, or to the end of the deque
+		live_iterator(ContainerPtr container, BaseIter it)
+			: m_container(container)
+			, m_it(std::move(it))
+		{
+		}
+
+		Value& dereference() const
+		{
+			return *m_it;
+		}
+
+		bool equal(const live_iterator& other) const
+		{
+			return m_it == other.m_it;
+		}
+
+		void increment()
+		{
+			++m_it;
+			if (m_container->m_nMarkedAsErased > 0) {
+				typename StdDeque::size_type pos = position();
+				m_it = m_container->m_tombstones.SkipForward(m_it, BaseIter(m_container->StdDeque::end()), pos);
+			}
+		}
+
+		void decrement()
+		{
+			--m_it;
+			if (m_container->m_nMarkedAsErased > 0) {
+				m_it = SkipBackward(m_container, m_it);
+			}
 		}
 	};
 
@@ -48,8 +431,11 @@ public:
 	using typename StdDeque::const_reference;
 
 	// A user-supplied key type
-	typedef typename T::KeyType key_type;
+	typedef typename KeyOf::template key_type<T> key_type;
 	typedef T value_type;
+	typedef typename std::conditional<std::is_same<CompareArg, DefaultKeyCompare>::value,
+									  std::less<key_type>, CompareArg>::type key_compare;
+	typedef KeyOf key_extractor;
 
 	// A key-type supporting quick access. Essentially a thin wrapper around indexes of the underlying deque class
 	class quick_key_type {
@@ -74,24 +460,41 @@ public:
 		~quick_key_type() = default;
 	};
 
-	typedef boost::filter_iterator<FilterPredicateType, typename StdDeque::iterator> iterator;
-	typedef boost::filter_iterator<FilterPredicateType, typename StdDeque::const_iterator> const_iterator;
-	typedef boost::filter_iterator<FilterPredicateType, typename StdDeque::reverse_iterator> reverse_iterator;
-	typedef boost::filter_iterator<FilterPredicateType, typename StdDeque::const_reverse_iterator> const_reverse_iterator;
+	// A read-only view of the keys in the underlying deque, including those of deleted values, used by search indexes
+	class key_view {
+		const StdDeque& m_deque;
+
+	public:
+		explicit key_view(const StdDeque& d)
+			: m_deque(d)
+		{
+		}
+
+		size_type size() const { return m_deque.size(); }
+		key_type operator[](size_type index) const { return KeyOf()(m_deque[index]); }
+		const void* address(size_type index) const { return & m_deque[index]; }
+	};
+
+	typedef live_iterator<InstrusiveSortedDeque*, typename StdDeque::iterator, T> iterator;
+	typedef live_iterator<const InstrusiveSortedDeque*, typename StdDeque::const_iterator, const T> const_iterator;
+	typedef std::reverse_iterator<iterator> reverse_iterator;
+	typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
 
 	InstrusiveSortedDeque( const_iterator first, const_iterator last, const allocator_type& alloc = allocator_type() )
 		: StdDeque(first, last, alloc)
 		, m_nMarkedAsErased(0)
 	{
+		OnReset();
 	}
 
 	InstrusiveSortedDeque( iterator first, iterator last, const allocator_type& alloc = allocator_type() )
 		: StdDeque(first, last, alloc)
 		, m_nMarkedAsErased(0)
 	{
+		OnReset();
 	}
 
-	InstrusiveSortedDeque(const InstrusiveSortedDeque<T>& other)
+	InstrusiveSortedDeque(const InstrusiveSortedDeque& other)
 		: InstrusiveSortedDeque(other.cbegin(), other.cend(), other.get_allocator())
 // FIXME: Aliasing the allocator might not be a good idea when we use custom allocators
 	{
@@ -99,9 +502,10 @@ public:
 
 	template< class InputIt >
 	InstrusiveSortedDeque( InputIt first, InputIt last, const allocator_type& alloc = allocator_type() )
-		: StdDeque(MakeFilteredIter(this, first), MakeFilteredIter(this, last), alloc)
+		: StdDeque(boost::make_filter_iterator<DetachedValueFilter>(first, last), boost::make_filter_iterator<DetachedValueFilter>(last, last), alloc)
 		, m_nMarkedAsErased(0)
 	{
+		OnReset();
 	}
 
 	InstrusiveSortedDeque()
@@ -112,16 +516,19 @@ public:
 
 	using StdDeque::deque;
 
-	InstrusiveSortedDeque<T>& operator=(const InstrusiveSortedDeque<T>& other)
+	InstrusiveSortedDeque& operator=(const InstrusiveSortedDeque& other)
 	{
 		Clone(other);
 		return *this;
 	}
 
-	InstrusiveSortedDeque<T>& operator=(InstrusiveSortedDeque<T>&& other)
+	InstrusiveSortedDeque& operator=(InstrusiveSortedDeque&& other)
 	{
 		static_cast<StdDeque*>(this)->operator=(other);
 		m_nMarkedAsErased = other.m_nMarkedAsErased;
+		m_tombstones = other.m_tombstones;
+		m_stats = other.m_stats;
+		m_searchIndex.OnReset(Keys());
 		return *this;
 	}
 
@@ -150,14 +557,14 @@ public:
 
 	iterator begin()
 	{
-		ValidateEdge(this->front());
-		return MakeFilteredIter(this, StdDeque::begin());
+		ValidateEdges();
+		return MakeIter(this, StdDeque::begin());
 	}
 
 	const_iterator begin() const
 	{
-		ValidateEdge(this->front());
-		return MakeFilteredIter(this, StdDeque::begin());
+		ValidateEdges();
+		return MakeIter(this, StdDeque::begin());
 	}
 
 	const_iterator cbegin() const
@@ -167,14 +574,14 @@ public:
 
 	iterator end()
 	{
-		ValidateEdge(this->back());
-		return MakeFilteredIter(this, StdDeque::end());
+		ValidateEdges();
+		return MakeIter(this, StdDeque::end());
 	}
 
 	const_iterator end() const
 	{
-		ValidateEdge(this->back());
-		return MakeFilteredIter(this, StdDeque::end());
+		ValidateEdges();
+		return MakeIter(this, StdDeque::end());
 	}
 
 	const_iterator cend() const
@@ -186,14 +593,12 @@ public:
 
 	reverse_iterator rbegin()
 	{
-		ValidateEdge(this->back());
-		return MakeFilteredIter(this, StdDeque::rbegin());
+		return reverse_iterator(end());
 	}
 
 	const_reverse_iterator rbegin() const
 	{
-		ValidateEdge(this->back());
-		return MakeFilteredIter(this, StdDeque::rbegin());
+		return const_reverse_iterator(end());
 	}
 
 	const_reverse_iterator crbegin() const
@@ -203,19 +608,17 @@ public:
 
 	reverse_iterator rend()
 	{
-		ValidateEdge(this->front());
-		return MakeFilteredIter(this, StdDeque::rend());
+		return reverse_iterator(begin());
 	}
 
 	const_reverse_iterator rend() const
 	{
-		ValidateEdge(this->front());
-		return MakeFilteredIter(this, StdDeque::rend());
+		return const_reverse_iterator(begin());
 	}
 
 	const_reverse_iterator crend() const
 	{
-		return end();
+		return const_reverse_iterator(begin());
 	}
 
 	iterator quick_key_to_iterator(quick_key_type qk)
@@ -247,12 +650,26 @@ public:
 		return StdDeque::size();
 	}
 
+	// The number of values in [first, last), which is negative if last precedes first. It takes constant time while
+	// there are no deleted values, or for the whole container, and otherwise subtracts the deleted values in between,
+	// as counted by the tombstones policy. That takes linear time, except with BitmapTombstones, which counts them
+	// 64 at a time.
+	typename StdDeque::difference_type count_live(const_iterator first, const_iterator last) const
+	{
+		return CountLive(first.position(), last.position());
+	}
+
+	key_compare key_comp() const
+	{
+		return m_compare;
+	}
+
 	// Find methods which return an iterator to the specified key using a binary search
 	const_iterator find(key_type k) const
 	{
 		typename StdDeque::const_iterator it;
 		DoFind(this, it, StdDeque::cbegin(), StdDeque::cend(), k);
-		return MakeFilteredIter(this, std::move(it));
+		return MakeIter(this, std::move(it));
 	}
 
 	// Find methods which return an iterator to the specified key using a binary search
@@ -260,27 +677,209 @@ public:
 	{
 		typename StdDeque::iterator it;
 		DoFind(this, it, StdDeque::begin(), StdDeque::end(), k);
-		return MakeFilteredIter(this, std::move(it));
+		return MakeIter(this, std::move(it));
+	}
+
+	// Heterogeneous find, for a transparent Compare. Returns the first value whose key is equivalent to k.
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	const_iterator find(const K& k) const
+	{
+		typename StdDeque::const_iterator it;
+		DoFind(this, it, StdDeque::cbegin(), StdDeque::cend(), k);
+		return MakeIter(this, std::move(it));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	iterator find(const K& k)
+	{
+		typename StdDeque::iterator it;
+		DoFind(this, it, StdDeque::begin(), StdDeque::end(), k);
+		return MakeIter(this, std::move(it));
+	}
+
+	// Ordered searches by key, which only return iterators to non-deleted values.
+	// Each also has a heterogeneous overload for a transparent Compare, enabled as for find().
+
+	// The first value whose key is not less than k
+	iterator lower_bound(key_type k)
+	{
+		return MakeIter(this, LowerBoundRaw(this, k));
+	}
+
+	const_iterator lower_bound(key_type k) const
+	{
+		return MakeIter(this, LowerBoundRaw(this, k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	iterator lower_bound(const K& k)
+	{
+		return MakeIter(this, LowerBoundRaw(this, k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	const_iterator lower_bound(const K& k) const
+	{
+		return MakeIter(this, LowerBoundRaw(this, k));
+	}
+
+	// The first value whose key is greater than k
+	iterator upper_bound(key_type k)
+	{
+		return MakeIter(this, UpperBoundRaw(this, k));
+	}
+
+	const_iterator upper_bound(key_type k) const
+	{
+		return MakeIter(this, UpperBoundRaw(this, k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	iterator upper_bound(const K& k)
+	{
+		return MakeIter(this, UpperBoundRaw(this, k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	const_iterator upper_bound(const K& k) const
+	{
+		return MakeIter(this, UpperBoundRaw(this, k));
+	}
+
+	// The range of values having the key k, which is empty if there is no such value
+	std::pair<iterator, iterator> equal_range(key_type k)
+	{
+		return std::make_pair(lower_bound(k), upper_bound(k));
+	}
+
+	std::pair<const_iterator, const_iterator> equal_range(key_type k) const
+	{
+		return std::make_pair(lower_bound(k), upper_bound(k));
+	}
+
+	// For a transparent Compare, k may be equivalent to several keys, such as when it is a prefix of them
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	std::pair<iterator, iterator> equal_range(const K& k)
+	{
+		return std::make_pair(lower_bound(k), upper_bound(k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	std::pair<const_iterator, const_iterator> equal_range(const K& k) const
+	{
+		return std::make_pair(lower_bound(k), upper_bound(k));
+	}
+
+	// The last value whose key is not greater than k, or end() if there is none
+	iterator floor(key_type k)
+	{
+		return MakeIter(this, FloorRaw(this, k));
+	}
+
+	const_iterator floor(key_type k) const
+	{
+		return MakeIter(this, FloorRaw(this, k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	iterator floor(const K& k)
+	{
+		return MakeIter(this, FloorRaw(this, k));
+	}
+
+	template <typename K, typename C = key_compare, typename = typename C::is_transparent>
+	const_iterator floor(const K& k) const
+	{
+		return MakeIter(this, FloorRaw(this, k));
+	}
+
+	// The value whose key is nearest to k, preferring the earlier one in case of a tie, or end() if there are no values.
+	// Requires the difference of keys to be defined.
+	iterator nearest(key_type k)
+	{
+		return Nearest(this, k);
+	}
+
+	const_iterator nearest(key_type k) const
+	{
+		return Nearest(this, k);
+	}
+
+	// Bulk access to the values whose keys are in the range [lo, hi), for processing them a block at a time.
+	// Invokes func(values, n, liveMask) on consecutive segments of at most SEGMENT_SIZE values, which are contiguous
+	// in memory, with bit i of liveMask set if values[i] is not deleted. Deleted values may be included in segments,
+	// so func should either skip them by the mask or leave their results unused. If hi is ordered before lo,
+	// the range is empty and func is not invoked.
+	enum { SEGMENT_SIZE = 64 };
+
+	template <typename Func>
+	void for_each_segment(key_type lo, key_type hi, Func&& func)
+	{
+		const auto first = LowerBoundRaw(this, lo);
+		ForEachSegment(this, first, std::max(first, LowerBoundRaw(this, hi)), func);
+	}
+
+	template <typename Func>
+	void for_each_segment(key_type lo, key_type hi, Func&& func) const
+	{
+		const auto first = LowerBoundRaw(this, lo);
+		ForEachSegment(this, first, std::max(first, LowerBoundRaw(this, hi)), func);
+	}
+
+	// Invokes func on the segments of all the values
+	template <typename Func>
+	void for_each_segment(Func&& func)
+	{
+		ForEachSegment(this, StdDeque::begin(), StdDeque::end(), func);
 	}
 
-	// An alternate find, starts by searching at the front of the deque before trying the usual search,
-	// and returns a 'quick key' instead of an iterator
+	template <typename Func>
+	void for_each_segment(Func&& func) const
+	{
+		ForEachSegment(this, StdDeque::begin(), StdDeque::end(), func);
+	}
+
+	// Invokes func on the segments of the values at the positions [first, last) of the underlying deque, as returned
+	// by iterator::position(), so that the values can be divided into parts, such as for processing them in parallel
+	template <typename Func>
+	void for_each_segment_at(size_type first, size_type last, Func&& func)
+	{
+		assert((first <= last) && (last <= capacity()));
+		ForEachSegment(this, StdDeque::begin() + first, StdDeque::begin() + last, func);
+	}
+
+	template <typename Func>
+	void for_each_segment_at(size_type first, size_type last, Func&& func) const
+	{
+		assert((first <= last) && (last <= capacity()));
+		ForEachSegment(this, StdDeque::begin() + first, StdDeque::begin() + last, func);
+	}
+
+	// An alternate find, which searches from the front of the deque using an exponential search, so that its cost
+	// is logarithmic in the distance of the key from the front, and returns a 'quick key' instead of an iterator
 	quick_key_type find_front(key_type userKey) const
 	{
-		if (! this->empty()) {
-			if (this->front().GetKey() == userKey) {
-				return quick_key_type(quick_key_type::MIN_VALID_INDEX);
-			}
-			else {
-				// TODO: cache the result that we find here, and try searching from the cached value.
-				typename StdDeque::const_iterator it;
-				if (DoFind(this, it, StdDeque::cbegin(), StdDeque::cend(), userKey)) {
-					return quick_key_type(it - StdDeque::cbegin());
-				}
-			}
-		}
+		return FindFromEdge<true, false>(userKey);
+	}
 
-		return quick_key_type();
+	// The counterpart of find_front(), which searches from the back of the deque
+	quick_key_type find_back(key_type userKey) const
+	{
+		return FindFromEdge<false, true>(userKey);
+	}
+
+	// Batch lookup: Writes the quick keys of the keys in the range [first, last) to result, in the same order.
+	// Keys which are not found yield invalid quick keys. Sorted keys are located by a single forward search,
+	// otherwise several binary searches are interleaved, prefetching the values which each will examine next,
+	// so that their cache misses overlap.
+	template <typename KeyIter, typename OutputIter>
+	OutputIter find_many(KeyIter first, KeyIter last, OutputIter result) const
+	{
+		FindManyIndexes(first, last, [&result](size_type index) {
+			*result++ = (INVALID_POSITION == index) ? quick_key_type() : quick_key_type(static_cast<int>(index));
+		});
+
+		return result;
 	}
 
 	void erase(iterator& it)
@@ -306,24 +905,78 @@ public:
 		return erase(StdDeque::begin() + k.m_index);
 	}
 
+	// Batch removal of the keys in the range [first, last), located as in find_many().
+	// The front and back are only trimmed once for the whole batch. Returns the number of values removed.
+	template <typename KeyIter>
+	size_type erase_many(KeyIter first, KeyIter last)
+	{
+		size_type nErased = 0;
+		FindManyIndexes(first, last, [this, &nErased](size_type index) {
+			if (INVALID_POSITION != index) {
+				m_tombstones.Remove(StdDeque::operator[](index), index);
+				++nErased;
+			}
+		});
+
+		m_nMarkedAsErased += nErased;
+		m_stats.OnErase(nErased);
+		TrimFront();
+		TrimBack();
+		CompactIfNeeded();
+		return nErased;
+	}
+
 	void pop_front()
 	{
-		assert(! this->empty() && ! this->front().IsDeleted());
+		assert(! this->empty() && ! IsDeletedAt(0));
 		StdDeque::pop_front();
-		TrimFront();
+		m_stats.OnErase(size_type(1));
+		TrimFront(1);
 	}
 
 	void pop_back()
 	{
-		assert(! this->empty() && ! this->back().IsDeleted());
+		assert(! this->empty() && ! IsDeletedAt(capacity() - 1));
 		StdDeque::pop_back();
-		TrimBack();
+		m_stats.OnErase(size_type(1));
+		TrimBack(1);
+	}
+
+	// Removes the deleted values from the underlying deque, moving the values following them.
+	// This invalidates all iterators and quick keys.
+	void compact()
+	{
+		if (m_nMarkedAsErased == 0) {
+			return;
+		}
+
+		size_type nLive = 0;
+		for (size_type index = 0; index < capacity(); ++index) {
+			if (! IsDeletedAt(index)) {
+				if (nLive != index) {
+					StdDeque::operator[](nLive) = std::move(StdDeque::operator[](index));
+				}
+
+				++nLive;
+			}
+		}
+
+		StdDeque::erase(StdDeque::begin() + nLive, StdDeque::end());
+		m_stats.OnCompact(m_nMarkedAsErased);
+		m_nMarkedAsErased = 0;
+		OnReset();
+	}
+
+	const Stats& stats() const
+	{
+		return m_stats;
 	}
 
 	void clear()
 	{
 		StdDeque::clear();
 		m_nMarkedAsErased = 0;
+		OnReset();
 		return;
 	}
 
@@ -340,7 +993,7 @@ public:
 	template< class InputIt >
 	void assign( InputIt first, InputIt last )
 	{
-		AssignFiltered(MakeFilteredIter(this, first), MakeFilteredIter(this, last));
+		AssignFiltered(boost::make_filter_iterator<DetachedValueFilter>(first, last), boost::make_filter_iterator<DetachedValueFilter>(last, last));
 	}
 
 	// Wrappers for emplace_back() and emplace_front(), which return references to the newly created values
@@ -354,20 +1007,24 @@ public:
 		const_pointer const prevBack = this->empty() ? nullptr : & (this->back());
 		StdDeque::emplace_back(std::forward<Args>(args)...);
 		reference& back = this->back();
-		assert(! back.IsDeleted());
+		assert(! Tombstones::IsDeletedValue(back));
 		if (nullptr != prevBack) {
-			assert(! prevBack->IsDeleted());
-			if (BOOST_UNLIKELY(back.GetKey() <= prevBack->GetKey())) {
-				assert(back.GetKey() < prevBack->GetKey());
-				auto it = DoFindUnchecked(StdDeque::begin(), StdDeque::end() - 1, back.GetKey());
-				assert((it->GetKey() > back.GetKey()) && (& *it != &back));
+			assert(! IsDeletedAt(capacity() - 2));
+			if (BOOST_UNLIKELY(! m_compare(KeyOfValue(*prevBack), KeyOfValue(back)))) {
+				assert(m_compare(KeyOfValue(back), KeyOfValue(*prevBack)));
+				auto it = DoFindUnchecked(this, StdDeque::begin(), StdDeque::end() - 1, KeyOfValue(back));
+				assert(m_compare(KeyOfValue(back), KeyOfValue(*it)) && (& *it != &back));
 				auto newIt = StdDeque::emplace(it, std::move(back));
 				StdDeque::pop_back();
-				ValidateEdge(this->back());
+				m_tombstones.OnInsert(capacity(), static_cast<size_type>(newIt - StdDeque::begin()));
+				ValidateEdges();
+				m_searchIndex.OnReset(Keys());
 				return *newIt;
 			}
 		}
 
+		m_tombstones.OnPushBack(capacity());
+		m_searchIndex.OnPushBack(Keys());
 		return back;
 	}
 
@@ -377,10 +1034,12 @@ public:
 	{
 		const_pointer const prevFront = this->empty() ? nullptr : & (this->front());
 		StdDeque::emplace_front(std::forward<Args>(args)...);
-		assert(! this->front().IsDeleted());
+		assert(! Tombstones::IsDeletedValue(this->front()));
+		m_tombstones.OnPushFront(capacity());
 		assert( (nullptr == prevFront) ||
-				((! prevFront->IsDeleted()) && (this->front().GetKey() < prevFront->GetKey())));
+				((! IsDeletedAt(1)) && m_compare(KeyOfValue(this->front()), KeyOfValue(*prevFront))));
 
+		m_searchIndex.OnPushFront(Keys());
 		return this->front();
 	}
 
@@ -389,33 +1048,184 @@ public:
 
 private:
 	typename StdDeque::size_type m_nMarkedAsErased = 0;
+	SearchIndex m_searchIndex;
+	key_compare m_compare;
+	Tombstones m_tombstones;
+	Compaction m_compaction;
+	mutable Stats m_stats;
 
-	void TrimFront()
+	key_view Keys() const
 	{
-		while (! this->empty() && this->front().IsDeleted()) {
-			StdDeque::pop_front();
-			--m_nMarkedAsErased;
+		return key_view(*this);
+	}
+
+	// Notify the tombstones policy and the search index that the deque was refilled with non-deleted values
+	void OnReset()
+	{
+		m_tombstones.OnReset(capacity());
+		m_searchIndex.OnReset(Keys());
+	}
+
+	bool IsDeletedAt(size_type pos) const
+	{
+		return m_tombstones.IsDeleted(StdDeque::operator[](pos), pos);
+	}
+
+	template <typename ThisType, typename IterType>
+	static bool IsDeletedAt(ThisType thisPtr, const IterType& it)
+	{
+		return thisPtr->m_tombstones.IsDeleted(*it, static_cast<size_type>(it - thisPtr->StdDeque::begin()));
+	}
+
+	// The last non-deleted value at or before it. Since the front value is never deleted, there always is one.
+	template <typename ThisType, typename IterType>
+	static IterType SkipBackward(ThisType thisPtr, IterType it)
+	{
+		size_type pos = it - thisPtr->StdDeque::begin();
+		return thisPtr->m_tombstones.SkipBackward(it, pos);
+	}
+
+	// Remove deleted values from the front, notifying the search index of these and of nPopped values already removed
+	void TrimFront(size_type nPopped = 0)
+	{
+		if (! this->empty()) {
+			// The tombstones are notified of the values already removed together with the deleted ones,
+			// so the front is still at position nPopped as far as they are concerned.
+			size_type pos = nPopped;
+			m_tombstones.SkipForward(StdDeque::begin(), StdDeque::end(), pos);
+			const size_type nDeleted = pos - nPopped;
+			for (size_type i = 0; i < nDeleted; ++i) {
+				StdDeque::pop_front();
+			}
+
+			m_nMarkedAsErased -= nDeleted;
+			m_stats.OnTrim(nDeleted);
+			nPopped += nDeleted;
 		}
+
+		if (nPopped > 0) {
+			m_tombstones.OnPopFront(capacity(), nPopped);
+			m_searchIndex.OnPopFront(Keys(), nPopped);
+		}
+
 		return;
 	}
 
-	void TrimBack()
+	void TrimBack(size_type nPopped = 0)
 	{
-		while (! this->empty() && this->back().IsDeleted()) {
+		const size_type nAlreadyPopped = nPopped;
+		while (! this->empty() && IsDeletedAt(capacity() - 1)) {
 			StdDeque::pop_back();
 			--m_nMarkedAsErased;
+			++nPopped;
 		}
+
+		m_stats.OnTrim(nPopped - nAlreadyPopped);
+		if (nPopped > 0) {
+			m_tombstones.OnPopBack(capacity(), nPopped);
+			m_searchIndex.OnPopBack(Keys(), nPopped);
+		}
+
 		return;
 	}
 
-	template <typename ThisType, typename IterType>
-	static bool DoFind(ThisType thisPtr, IterType& result, IterType&& beginIter, IterType&& endIter, key_type k)
+	// The number of values in each block of the underlying deque, or 0 if it's unknown. The standard doesn't expose it,
+	// so it's only taken from the internals of libstdc++, unless UTILS_SORTED_DEQUE_NO_LIBRARY_BLOCK_SIZE is defined.
+	// ForEachSegment() checks it against the addresses of the values, and falls back to scanning them if it's wrong.
+	static constexpr size_type DequeBlockSize()
+	{
+#if defined(__GLIBCXX__) && ! defined(UTILS_SORTED_DEQUE_NO_LIBRARY_BLOCK_SIZE)
+		return std::__deque_buf_size(sizeof(T));		// Internal to libstdc++
+#else
+		return 0;
+#endif
+	}
+
+	template <typename ThisType, typename IterType, typename Func>
+	static void ForEachSegment(ThisType thisPtr, IterType first, IterType last, Func& func)
 	{
-		if (! thisPtr->empty() && (k <= thisPtr->back().GetKey())) {
-			result = DoFindUnchecked(beginIter, endIter, k);
+		// The deque is only contiguous within each of its blocks, so a segment ends at the end of a block.
+		// The addresses of the values are scanned until a change of block is found, after which the following segments
+		// are cut to the block boundaries without scanning, if the size of the blocks is known. It is not learned from
+		// the addresses, since consecutive blocks may happen to be adjacent in memory.
+		size_type blockSize = DequeBlockSize();
+		size_type pos = first - thisPtr->StdDeque::begin();
+		size_type offsetInBlock = INVALID_POSITION;
+		while (first != last) {
+			const size_type maxSize = std::min<size_type>(last - first, SEGMENT_SIZE);
+			auto* const values = std::addressof(*first);
+			size_type n = 0;
+			if (offsetInBlock != INVALID_POSITION) {
+				n = std::min(maxSize, blockSize - offsetInBlock);
+				if (std::addressof(first[n - 1]) == values + (n - 1)) {
+					first += n;
+					offsetInBlock = (offsetInBlock + n) % blockSize;
+				}
+				else {
+					// The block size doesn't match the library, so the remaining values are scanned
+					blockSize = 0;
+					offsetInBlock = INVALID_POSITION;
+					n = 0;
+				}
+			}
+
+			if (n == 0) {
+				for (n = 1, ++first; (n < maxSize) && (std::addressof(*first) == values + n); ++first) {
+					++n;
+				}
+
+				if ((blockSize > 0) && (first != last) && (std::addressof(*first) != values + n)) {
+					offsetInBlock = 0;
+				}
+			}
+
+			func(values, n, thisPtr->m_tombstones.LiveMask(values, pos, n));
+			pos += n;
+		}
+	}
+
+	void CompactIfNeeded()
+	{
+		if (m_compaction.ShouldCompact(capacity(), m_nMarkedAsErased)) {
+			compact();
+		}
+	}
+
+	template <typename ThisType, typename IterType, typename K>
+	static bool DoFind(ThisType thisPtr, IterType& result, IterType&& beginIter, IterType&& endIter, const K& k)
+	{
+		const bool found = DoFindUncounted(thisPtr, result, std::move(beginIter), std::move(endIter), k);
+		thisPtr->m_stats.OnFind(found);
+		return found;
+	}
+
+	template <typename ThisType, typename IterType, typename K>
+	static bool DoFindUncounted(ThisType thisPtr, IterType& result, IterType&& beginIter, IterType&& endIter, const K& k)
+	{
+		if (! thisPtr->empty() && ! thisPtr->m_compare(KeyOfValue(thisPtr->back()), k)) {
+			size_type pos = 0;
+			switch (thisPtr->IndexLookup(k, pos)) {
+			case SEARCH_INDEX_FOUND:
+				result = beginIter + pos;
+				if ((result < endIter) && ! IsDeletedAt(thisPtr, result)) {
+					return true;
+				}
+
+				result = thisPtr->StdDeque::end();
+				return false;
+
+			case SEARCH_INDEX_ABSENT:
+				result = thisPtr->StdDeque::end();
+				return false;
+
+			default:
+				break;
+			}
+
+			result = DoFindIndexed(thisPtr, beginIter, endIter, k);
 			// FIXME: We should handle cases when endIter != StdDeque::end()
 			assert(result != thisPtr->StdDeque::end());
-			if ((result->GetKey() == k) && (endIter != result)) {
+			if (! thisPtr->m_compare(k, KeyOfValue(*result)) && (endIter != result) && ! IsDeletedAt(thisPtr, result)) {
 				return true;
 			}
 		}
@@ -424,19 +1234,257 @@ private:
 		return false;
 	}
 
-	template <typename IterType>
-	static inline auto DoFindUnchecked(IterType&& beginIter, IterType&& endIter, key_type k)
+	// The first value in the underlying deque, deleted or not, whose key is not less than k
+	template <typename ThisType, typename K>
+	static auto LowerBoundRaw(ThisType thisPtr, const K& k)
 	{
-		constexpr auto FindComp = [](const T& value, typename T::KeyType k)->bool { return value.GetKey() < k; };
-		return std::lower_bound(beginIter, endIter, k, FindComp);
+		auto beginIter = thisPtr->StdDeque::begin();
+		auto endIter = thisPtr->StdDeque::end();
+		if (thisPtr->empty()) {
+			return endIter;
+		}
+
+		return DoFindIndexed(thisPtr, beginIter, endIter, k);
+	}
+
+	// The first value in the underlying deque whose key is greater than k, relying on the keys being unique
+	template <typename ThisType>
+	static auto UpperBoundRaw(ThisType thisPtr, key_type k)
+	{
+		auto it = LowerBoundRaw(thisPtr, k);
+		if ((it != thisPtr->StdDeque::end()) && ! thisPtr->m_compare(k, KeyOfValue(*it))) {
+			++it;
+		}
+
+		return it;
+	}
+
+	// A heterogeneous k may be equivalent to any number of keys, so the values following the lower bound are searched too
+	template <typename ThisType, typename K>
+	static auto UpperBoundRaw(ThisType thisPtr, const K& k)
+	{
+		const auto endIter = thisPtr->StdDeque::end();
+		const auto it = LowerBoundRaw(thisPtr, k);
+		if ((it == endIter) || thisPtr->m_compare(k, KeyOfValue(*it))) {
+			return it;
+		}
+
+		const key_compare& comp = thisPtr->m_compare;
+		return std::upper_bound(it, endIter, k, [&comp](const K& k, const value_type& value)->bool {
+			return comp(k, KeyOfValue(value));
+		});
+	}
+
+	// The last non-deleted value whose key is not greater than k, or the end of the underlying deque
+	template <typename ThisType, typename K>
+	static auto FloorRaw(ThisType thisPtr, const K& k)
+	{
+		auto it = UpperBoundRaw(thisPtr, k);
+		if (it == thisPtr->StdDeque::begin()) {
+			return thisPtr->StdDeque::end();
+		}
+
+		// The front value is never deleted, so this stops at the front at the latest
+		return SkipBackward(thisPtr, --it);
+	}
+
+	template <typename ThisType>
+	static auto Nearest(ThisType thisPtr, key_type k)
+	{
+		auto ceiling = MakeIter(thisPtr, LowerBoundRaw(thisPtr, k));
+		auto floor = MakeIter(thisPtr, FloorRaw(thisPtr, k));
+		const auto endIter = MakeIter(thisPtr, thisPtr->StdDeque::end());
+		if ((ceiling == endIter) || ((floor != endIter) && ! (Distance(KeyOfValue(*ceiling), k) < Distance(KeyOfValue(*floor), k)))) {
+			return floor;
+		}
+
+		return ceiling;
+	}
+
+	static key_type Distance(const key_type& a, const key_type& b)
+	{
+		return (a < b) ? b - a : a - b;
+	}
+
+	// Search indexes are keyed by key_type, so heterogeneous searches bypass them
+	template <typename K>
+	SearchIndexLookup IndexLookup(const K&, size_type&) const
+	{
+		return SEARCH_INDEX_UNKNOWN;
+	}
+
+	SearchIndexLookup IndexLookup(const key_type& k, size_type& pos) const
+	{
+		return m_searchIndex.Lookup(Keys(), k, pos);
+	}
+
+	template <typename K>
+	bool IndexNarrow(const K&, size_type&, size_type&) const
+	{
+		return false;
+	}
+
+	bool IndexNarrow(const key_type& k, size_type& lo, size_type& hi) const
+	{
+		return m_searchIndex.Narrow(Keys(), k, lo, hi);
+	}
+
+	// Search for the lower bound of k within the range narrowed by the search index, if it could narrow it.
+	// The range should span the entire underlying deque.
+	template <typename ThisType, typename IterType, typename K>
+	static inline auto DoFindIndexed(ThisType thisPtr, IterType& beginIter, IterType& endIter, const K& k)
+	{
+		size_type lo = 0;
+		size_type hi = endIter - beginIter;
+		if (thisPtr->IndexNarrow(k, lo, hi)) {
+			assert((lo <= hi) && (hi <= thisPtr->capacity()));
+			return DoFindUnchecked(thisPtr, beginIter + lo, beginIter + hi, k);
+		}
+
+		return DoFindUnchecked(thisPtr, beginIter, endIter, k);
+	}
+
+	static inline decltype(auto) KeyOfValue(const T& value)
+	{
+		return KeyOf()(value);
+	}
+
+	// Gallops from the edge only without a search index, since an index locates the key, or narrows the range
+	// containing it, at a cost which doesn't depend on its distance from the edge
+	template <bool FROM_FRONT, bool FROM_BACK>
+	quick_key_type FindFromEdge(key_type userKey) const
+	{
+		const auto first = StdDeque::cbegin();
+		if (! std::is_same<SearchIndex, NoSearchIndex>::value) {
+			typename StdDeque::const_iterator it;
+			if (DoFindUncounted(this, it, StdDeque::cbegin(), StdDeque::cend(), userKey)) {
+				return quick_key_type(static_cast<int>(it - first));
+			}
+		}
+		else if (! this->empty()) {
+			const auto last = StdDeque::cend();
+			const auto it = EdgeGallopingSearchPolicy::Gallop<FROM_FRONT, FROM_BACK>(first, last, userKey, KeyOf(), m_compare);
+			if ((it != last) && ! m_compare(userKey, KeyOfValue(*it)) && ! IsDeletedAt(this, it)) {
+				return quick_key_type(static_cast<int>(it - first));
+			}
+		}
+
+		return quick_key_type();
+	}
+
+	template <typename ThisType, typename IterType, typename K>
+	static inline auto DoFindUnchecked(ThisType thisPtr, IterType&& beginIter, IterType&& endIter, const K& k)
+	{
+		return SearchPolicy::LowerBound(beginIter, endIter, k, KeyOf(), thisPtr->m_compare);
+	}
+
+	static constexpr size_type INVALID_POSITION = static_cast<size_type>(-1);
+	enum { FIND_MANY_GROUP_SIZE = 8 };
+
+	static inline void Prefetch(const void* p)
+	{
+#if defined(__GNUC__)
+		__builtin_prefetch(p);
+#else
+		(void) p;
+#endif
+	}
+
+	// Invokes onResult with the index of each of the keys in [first, last), or INVALID_POSITION if it's not present
+	template <typename KeyIter, typename Func>
+	void FindManyIndexes(KeyIter first, KeyIter last, Func&& onResult) const
+	{
+		if (this->empty()) {
+			for (; first != last; ++first) {
+				onResult(INVALID_POSITION);
+			}
+		}
+		else if (std::is_sorted(first, last, m_compare)) {
+			FindManySorted(first, last, onResult);
+		}
+		else {
+			FindManyInterleaved(first, last, onResult);
+		}
+	}
+
+	// Search for each key by galloping forward from the position of the previous key
+	template <typename KeyIter, typename Func>
+	void FindManySorted(KeyIter first, KeyIter last, Func& onResult) const
+	{
+		const size_type n = capacity();
+		size_type lo = 0;
+		for (; first != last; ++first) {
+			const key_type k = *first;
+			size_type step = 1;
+			while ((lo + step < n) && m_compare(KeyAt(lo + step), k)) {
+				lo += step;
+				step *= 2;
+			}
+
+			const auto base = StdDeque::cbegin();
+			lo = DoFindUnchecked(this, base + lo, base + std::min(lo + step + 1, n), k) - base;
+			onResult(IndexIfLive(lo, k));
+		}
+	}
+
+	// Perform the binary searches for a group of keys in lock-step, prefetching both candidates for each next probe
+	template <typename KeyIter, typename Func>
+	void FindManyInterleaved(KeyIter first, KeyIter last, Func& onResult) const
+	{
+		const size_type n = capacity();
+		std::array<key_type, FIND_MANY_GROUP_SIZE> keys;
+		std::array<size_type, FIND_MANY_GROUP_SIZE> lows;
+		while (first != last) {
+			size_type nKeys = 0;
+			for (; (first != last) && (nKeys < FIND_MANY_GROUP_SIZE); ++first, ++nKeys) {
+				keys[nKeys] = *first;
+				lows[nKeys] = 0;
+			}
+
+			for (size_type len = n; len > 1; ) {
+				const size_type half = len / 2;
+				for (size_type i = 0; i < nKeys; ++i) {
+					Prefetch(& StdDeque::operator[](lows[i] + half / 2));
+					Prefetch(& StdDeque::operator[](lows[i] + half + half / 2));
+				}
+
+				for (size_type i = 0; i < nKeys; ++i) {
+					lows[i] = m_compare(KeyAt(lows[i] + half), keys[i]) ? lows[i] + half : lows[i];
+				}
+
+				len -= half;
+			}
+
+			for (size_type i = 0; i < nKeys; ++i) {
+				const size_type pos = lows[i] + (m_compare(KeyAt(lows[i]), keys[i]) ? 1 : 0);
+				onResult(IndexIfLive(pos, keys[i]));
+			}
+		}
+	}
+
+	key_type KeyAt(size_type index) const
+	{
+		return KeyOfValue(StdDeque::operator[](index));
+	}
+
+	size_type IndexIfLive(size_type index, key_type k) const
+	{
+		if (index < capacity()) {
+			const value_type& value = StdDeque::operator[](index);
+			if (! m_compare(k, KeyOfValue(value)) && ! m_tombstones.IsDeleted(value, index)) {
+				return index;
+			}
+		}
+
+		return INVALID_POSITION;
 	}
 
 	void Clone(const InstrusiveSortedDeque& other)
 	{
 		StdDeque::resize(other.size());		// Pre-allocate space if necessary
-		constexpr auto pred = [](const value_type& r) { return ! r.IsDeleted(); };
-		std::copy_if(other.StdDeque::begin(), other.StdDeque::end(), StdDeque::begin(), pred);
+		std::copy(other.begin(), other.end(), StdDeque::begin());
 		m_nMarkedAsErased = 0;
+		OnReset();
 	}
 
 	template <typename RefType, typename ThisType>
@@ -450,19 +1498,46 @@ private:
 	{
 		if (qk.is_valid()) {
 			auto it = thisPtr->StdDeque::begin() + qk.m_index;
-			if (! it->IsDeleted()) {
-				return MakeFilteredIter(thisPtr, std::move(it));
+			if (! IsDeletedAt(thisPtr, it)) {
+				return MakeIter(thisPtr, std::move(it));
 			}
 		}
 
-		return MakeFilteredIter(thisPtr, thisPtr->StdDeque::end());
+		return MakeIter(thisPtr, thisPtr->StdDeque::end());
+	}
+
+	// Wraps an iterator of the deque, skipping forward to a non-deleted value if it refers to a deleted one
+	inline static iterator MakeIter(InstrusiveSortedDeque* thisPtr, typename StdDeque::iterator baseIter)
+	{
+		size_type pos = baseIter - thisPtr->StdDeque::begin();
+		baseIter = thisPtr->m_tombstones.SkipForward(baseIter, thisPtr->StdDeque::end(), pos);
+		return iterator(thisPtr, baseIter);
+	}
+
+	inline static const_iterator MakeIter(const InstrusiveSortedDeque* thisPtr, typename StdDeque::const_iterator baseIter)
+	{
+		size_type pos = baseIter - thisPtr->StdDeque::begin();
+		baseIter = thisPtr->m_tombstones.SkipForward(baseIter, thisPtr->StdDeque::end(), pos);
+		return const_iterator(thisPtr, baseIter);
 	}
 
-	// Filter iterator wrapping implementation
-	template <typename ThisType, typename BaseIterType>
-	inline static boost::filter_iterator<FilterPredicateType, BaseIterType> MakeFilteredIter(ThisType thisPtr, BaseIterType&& baseIter)
+	// The number of non-deleted values in the positions [first, last), which is negative if last precedes first
+	typename StdDeque::difference_type CountLive(size_type first, size_type last) const
 	{
-		return boost::make_filter_iterator<FilterPredicateType>(baseIter, thisPtr->StdDeque::end());
+		if (last < first) {
+			return -CountLive(last, first);
+		}
+
+		const size_type n = last - first;
+		if ((m_nMarkedAsErased == 0) || (n == 0)) {
+			return n;
+		}
+
+		if (n == capacity()) {
+			return size();
+		}
+
+		return n - m_tombstones.CountDeleted(StdDeque::begin() + first, first, n);
 	}
 
 	template< class InputIt >
@@ -470,29 +1545,30 @@ private:
 	{
 		StdDeque::assign(first, last);
 		m_nMarkedAsErased = 0;
+		OnReset();
 	}
 
-	// Validate that a value is a valid fron or back value
-	void ValidateEdge(const value_type& v) const
+	// Validate that the front and back values are not deleted
+	void ValidateEdges() const
 	{
-		// Note that if the deque is empty, the reference to v might be garbage.
-		assert(this->empty() || ! v.IsDeleted());
+		assert(this->empty() || (! IsDeletedAt(0) && ! IsDeletedAt(capacity() - 1)));
 	}
 
 	bool erase(typename StdDeque::iterator it)
 	{
-		if (! it->IsDeleted()) {
-			it->Remove();
-			assert(it->IsDeleted());
+		const size_type pos = it - StdDeque::begin();
+		if (! m_tombstones.IsDeleted(*it, pos)) {
+			m_tombstones.Remove(*it, pos);
 			++m_nMarkedAsErased;
+			m_stats.OnErase(size_type(1));
 			TrimFront();
 			TrimBack();
+			CompactIfNeeded();
 			return true;
 		}
 		else {
 			assert((capacity() > 1) && (m_nMarkedAsErased > 0));
-			ValidateEdge(this->front());
-			ValidateEdge(this->back());
+			ValidateEdges();
 			return false;
 		}
 	}
@@ -0,0 +1,267 @@
+/*
+ * LazySortedDeque.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_LAZYSORTEDDEQUE_H_
+#define UTILS_LAZYSORTEDDEQUE_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "IntrusiveSortedDeque.h"
+
+namespace Utils {
+
+// LazySortedDeque: Ingests values in any order by appending them to an unsorted pending buffer, with no comparisons,
+// and merges them into a sorted InstrusiveSortedDeque, or any container of its kind, only once they are read.
+// Each read which follows some appends, such as find(), begin() or front(), first sorts the pending values and merges
+// them, so a burst of values which are out of order costs a single sort and merge, rather than an insertion in the
+// middle of the deque for each of them. The merge only moves the sorted values whose keys are not less than the
+// smallest pending key, so values which are mostly in order are merged at little more than the cost of appending them.
+// Of the values with equal keys, the one appended last is kept, replacing any earlier value in the sorted container.
+// As with InstrusiveSortedDeque::emplace_back(), the values appended must not be deleted.
+// Since even the const reads merge the pending values, a LazySortedDeque may not be read by several threads at once.
+// Appending doesn't invalidate the iterators of the sorted container, but the next read following it does.
+
+template <typename Container>
+class LazySortedDeque {
+public:
+	typedef Container container_type;
+	typedef typename Container::value_type value_type;
+	typedef typename Container::key_type key_type;
+	typedef typename Container::size_type size_type;
+	typedef typename Container::reference reference;
+	typedef typename Container::const_reference const_reference;
+	typedef typename Container::iterator iterator;
+	typedef typename Container::const_iterator const_iterator;
+
+	LazySortedDeque() = default;
+
+	// Appends a value constructed from args, which is merged on the next read
+	template< typename... Args >
+	void emplace_back(Args&&... args)
+	{
+		m_pending.emplace_back(std::forward<Args>(args)...);
+	}
+
+	void push_back(const value_type& value)
+	{
+		m_pending.push_back(value);
+	}
+
+	void push_back(value_type&& value)
+	{
+		m_pending.push_back(std::move(value));
+	}
+
+	// The number of values appended since the last read
+	size_type pending_size() const
+	{
+		return m_pending.size();
+	}
+
+	// Merges the pending values into the sorted container, as any read does
+	void flush() const
+	{
+		if (! m_pending.empty()) {
+			Merge();
+		}
+	}
+
+	// The sorted container, after merging the pending values
+	container_type& sorted()
+	{
+		flush();
+		return m_sorted;
+	}
+
+	const container_type& sorted() const
+	{
+		flush();
+		return m_sorted;
+	}
+
+	size_type size() const
+	{
+		return sorted().size();
+	}
+
+	bool empty() const
+	{
+		return m_pending.empty() && m_sorted.empty();
+	}
+
+	iterator find(key_type k)
+	{
+		return sorted().find(k);
+	}
+
+	const_iterator find(key_type k) const
+	{
+		return sorted().find(k);
+	}
+
+	iterator lower_bound(key_type k)
+	{
+		return sorted().lower_bound(k);
+	}
+
+	const_iterator lower_bound(key_type k) const
+	{
+		return sorted().lower_bound(k);
+	}
+
+	iterator begin()
+	{
+		return sorted().begin();
+	}
+
+	const_iterator begin() const
+	{
+		return sorted().begin();
+	}
+
+	iterator end()
+	{
+		return sorted().end();
+	}
+
+	const_iterator end() const
+	{
+		return sorted().end();
+	}
+
+	reference front()
+	{
+		return sorted().front();
+	}
+
+	const_reference front() const
+	{
+		return sorted().front();
+	}
+
+	reference back()
+	{
+		return sorted().back();
+	}
+
+	const_reference back() const
+	{
+		return sorted().back();
+	}
+
+	bool erase(key_type k)
+	{
+		return sorted().erase(k);
+	}
+
+	void pop_front()
+	{
+		sorted().pop_front();
+	}
+
+	void clear()
+	{
+		m_pending.clear();
+		m_sorted.clear();
+	}
+
+private:
+	mutable container_type m_sorted;
+	mutable std::vector<value_type> m_pending;
+
+	static key_type KeyOf(const value_type& value)
+	{
+		return typename Container::key_extractor()(value);
+	}
+
+	// The maximal number of sorted values to move for each pending value, above which the pending values are inserted
+	// into the sorted container one by one instead of being merged with the values following them
+	enum { MAX_MOVES_PER_VALUE = 4 };
+
+	// Sorts the pending values stably, so that the last of the values with equal keys can be told, and then pops the
+	// sorted values which aren't less than the smallest of them and appends the union of both in order, so that each
+	// value is appended at the back of the sorted container, and its search index is updated incrementally
+	void Merge() const
+	{
+		const typename Container::key_compare comp = m_sorted.key_comp();
+		std::stable_sort(m_pending.begin(), m_pending.end(), [&comp](const value_type& a, const value_type& b) {
+			return comp(KeyOf(a), KeyOf(b));
+		});
+
+		// Values may only be inserted where there are no deleted values, which might have the same keys
+		const auto nDisplaced = m_sorted.count_live(m_sorted.lower_bound(KeyOf(m_pending.front())), m_sorted.end());
+		if ((m_sorted.capacity() == m_sorted.size()) && (static_cast<size_type>(nDisplaced) > MAX_MOVES_PER_VALUE * m_pending.size())) {
+			InsertEach(comp);
+			return;
+		}
+
+		std::vector<value_type> displaced;
+		while (! m_sorted.empty() && ! comp(KeyOf(m_sorted.back()), KeyOf(m_pending.front()))) {
+			displaced.push_back(m_sorted.back());
+			m_sorted.pop_back();
+		}
+
+		auto nextDisplaced = displaced.rbegin();
+		for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+			if (IsReplaced(comp, it)) {
+				continue;
+			}
+
+			for (; (nextDisplaced != displaced.rend()) && comp(KeyOf(*nextDisplaced), KeyOf(*it)); ++nextDisplaced) {
+				m_sorted.emplace_back(std::move(*nextDisplaced));
+			}
+
+			// A displaced value with the same key is replaced by the appended one
+			if ((nextDisplaced != displaced.rend()) && ! comp(KeyOf(*it), KeyOf(*nextDisplaced))) {
+				++nextDisplaced;
+			}
+
+			m_sorted.emplace_back(std::move(*it));
+		}
+
+		for (; nextDisplaced != displaced.rend(); ++nextDisplaced) {
+			m_sorted.emplace_back(std::move(*nextDisplaced));
+		}
+
+		m_pending.clear();
+	}
+
+	// Inserts the sorted pending values one by one, for a few values whose keys are far from the back, replacing the
+	// values with the same keys in place, since they keep their positions
+	template <typename Compare>
+	void InsertEach(const Compare& comp) const
+	{
+		for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+			if (IsReplaced(comp, it)) {
+				continue;
+			}
+
+			const auto existing = m_sorted.find(KeyOf(*it));
+			if (existing != m_sorted.end()) {
+				*existing = std::move(*it);
+			}
+			else {
+				m_sorted.emplace_back(std::move(*it));
+			}
+		}
+
+		m_pending.clear();
+	}
+
+	// Whether a sorted pending value is followed by another one with the same key, which replaces it
+	template <typename Compare, typename Iter>
+	bool IsReplaced(const Compare& comp, Iter it) const
+	{
+		return (it + 1 != m_pending.end()) && ! comp(KeyOf(*it), KeyOf(*(it + 1)));
+	}
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_LAZYSORTEDDEQUE_H_ */
@@ -0,0 +1,541 @@
+/*
+ * SeqLockSortedDeque.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SEQLOCKSORTEDDEQUE_H_
+#define UTILS_SEQLOCKSORTEDDEQUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "IntrusiveSortedDeque.h"
+#include "SortedDequeSnapshot.h"
+
+namespace Utils {
+
+// EpochReclaimer: Defers freeing memory released by a single writer thread until all the reader threads which might
+// still be reading it are done. Readers register in one of two reader counts, selected by the parity of the current epoch.
+// Retired memory is held until the writer completes its modification, after which the epoch is advanced, and it is freed
+// once all the readers registered in the previous epoch have left.
+// Readers are spread over several cache-line aligned stripes, so that they don't contend with each other.
+
+class EpochReclaimer {
+public:
+	EpochReclaimer() = default;
+	EpochReclaimer(const EpochReclaimer&) = delete;
+	EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+	~EpochReclaimer()
+	{
+		FreeAll(m_draining);
+		FreeAll(m_pending);
+	}
+
+	// Reader side: Returns the epoch, which should be passed to ExitRead()
+	unsigned EnterRead()
+	{
+		auto& stripe = m_stripes[ThisThreadStripe()];
+		for (;;) {
+			const unsigned epoch = m_epoch.load(std::memory_order_seq_cst);
+			stripe.m_nActive[epoch & 1].fetch_add(1, std::memory_order_seq_cst);
+			if (BOOST_LIKELY(m_epoch.load(std::memory_order_seq_cst) == epoch)) {
+				return epoch;
+			}
+
+			stripe.m_nActive[epoch & 1].fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	void ExitRead(unsigned epoch)
+	{
+		m_stripes[ThisThreadStripe()].m_nActive[epoch & 1].fetch_sub(1, std::memory_order_release);
+	}
+
+	// Writer side: Memory passed to Retire() should have been allocated by ::operator new
+	void Retire(void* p)
+	{
+		m_pending.push_back(p);
+	}
+
+	// Writer side: Should be called once a modification is complete, so that no new reader can reach the retired memory
+	void OnWriteComplete()
+	{
+		if (! m_draining.empty()) {
+			const unsigned previousParity = (m_epoch.load(std::memory_order_relaxed) - 1) & 1;
+			if (! HasReaders(previousParity)) {
+				FreeAll(m_draining);
+			}
+		}
+
+		if (m_draining.empty() && ! m_pending.empty()) {
+			m_draining.swap(m_pending);
+			m_epoch.fetch_add(1, std::memory_order_seq_cst);
+		}
+	}
+
+private:
+	enum { N_STRIPES = 16, CACHE_LINE_SIZE = 64 };
+
+	struct alignas(CACHE_LINE_SIZE) Stripe {
+		std::array<std::atomic<unsigned>, 2> m_nActive {};
+	};
+
+	std::atomic<unsigned> m_epoch { 0 };
+	std::array<Stripe, N_STRIPES> m_stripes;
+	std::vector<void*> m_pending;		// Retired during the current epoch
+	std::vector<void*> m_draining;		// Retired during the previous epoch
+
+	static std::size_t ThisThreadStripe()
+	{
+		static thread_local const std::size_t stripe = std::hash<std::thread::id>()(std::this_thread::get_id()) % N_STRIPES;
+		return stripe;
+	}
+
+	bool HasReaders(unsigned parity) const
+	{
+		for (const Stripe& stripe : m_stripes) {
+			if (0 != stripe.m_nActive[parity].load(std::memory_order_acquire)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static void FreeAll(std::vector<void*>& retired)
+	{
+		for (void* p : retired) {
+			::operator delete(p);
+		}
+
+		retired.clear();
+	}
+};
+
+// An allocator which passes deallocated memory to an EpochReclaimer instead of freeing it
+template <typename T>
+class EpochDeferredAllocator {
+	template <typename U> friend class EpochDeferredAllocator;
+	EpochReclaimer* m_pReclaimer;
+
+public:
+	typedef T value_type;
+
+	explicit EpochDeferredAllocator(EpochReclaimer* pReclaimer)
+		: m_pReclaimer(pReclaimer)
+	{
+	}
+
+	template <typename U>
+	EpochDeferredAllocator(const EpochDeferredAllocator<U>& other)
+		: m_pReclaimer(other.m_pReclaimer)
+	{
+	}
+
+	T* allocate(std::size_t n)
+	{
+		return static_cast<T*>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(T* p, std::size_t)
+	{
+		m_pReclaimer->Retire(p);
+	}
+
+	template <typename U>
+	bool operator==(const EpochDeferredAllocator<U>& other) const { return m_pReclaimer == other.m_pReclaimer; }
+
+	template <typename U>
+	bool operator!=(const EpochDeferredAllocator<U>& other) const { return m_pReclaimer != other.m_pReclaimer; }
+};
+
+// SeqLockSortedDeque: An InstrusiveSortedDeque shared between a single writer thread and any number of reader threads.
+// The writer increments a version counter before and after each modification, so that the version is odd while
+// a modification is in progress. Readers perform optimistic reads, copying values out, and retry if the version was odd
+// or has changed by the time they are done. Readers never take a lock, and only write to their own reclaimer stripe.
+//
+// Since a reader may observe the container in the middle of a modification, values are only ever copied out, and are
+// only returned after the version has been validated. Hence T must be trivially copyable. The values, and the deque's
+// own bookkeeping, are read with plain loads while the writer may be changing them, which is formally a data race,
+// and is reported as such by race detectors. Only the results of reads which the version validates are used.
+// Nor can the iterators of the deque be moved safely while it changes, since the deque may rearrange its map of blocks
+// in place, so readers only move them by the number of values which the deque held when the read began.
+// Memory released by the deque during a modification is only freed by the EpochReclaimer after all the readers which
+// might have reached it are done, so that racing readers only ever read memory which is still allocated.
+// Readers which need a consistent view for longer may take an immutable snapshot(), which shares unchanged segments
+// with the previous snapshot. In order to determine which segments may be shared, the writer logs the keys at which
+// values were inserted or removed other than by appending them at the back.
+
+template <typename T>
+class SeqLockSortedDeque {
+	static_assert(std::is_trivially_copyable<T>::value, "Values are copied by readers while they may be modified");
+
+public:
+	typedef InstrusiveSortedDeque<T, EpochDeferredAllocator<T> > container_type;
+	typedef typename container_type::key_type key_type;
+	typedef typename container_type::size_type size_type;
+	typedef T value_type;
+	typedef std::uint64_t version_type;
+	typedef SortedDequeSnapshot<T> snapshot_type;
+
+	SeqLockSortedDeque()
+		: m_container(EpochDeferredAllocator<T>(&m_reclaimer))
+	{
+	}
+
+	SeqLockSortedDeque(const SeqLockSortedDeque&) = delete;
+	SeqLockSortedDeque& operator=(const SeqLockSortedDeque&) = delete;
+
+	// Writer interface. These methods should only be called from the writer thread.
+
+	template< typename... Args >
+	void emplace_back(Args&&... args)
+	{
+		WriteGuard guard(*this);
+		const T& value = m_container.emplace_back(std::forward<Args>(args)...);
+		if (BOOST_UNLIKELY(&value != &m_container.StdDeque::back())) {
+			LogChange(value.GetKey());
+		}
+	}
+
+	bool erase(key_type k)
+	{
+		WriteGuard guard(*this);
+		if (m_container.erase(k)) {
+			LogChange(k);
+			return true;
+		}
+
+		return false;
+	}
+
+	// Logged as pop_back() is, since a value inserted below the front would otherwise hide the popped values from
+	// snapshot(), which would still share the segments holding them
+	void pop_front()
+	{
+		WriteGuard guard(*this);
+		LogChange(m_container.StdDeque::front().GetKey());
+		m_container.pop_front();
+	}
+
+	void pop_back()
+	{
+		WriteGuard guard(*this);
+		LogChange(m_container.StdDeque::back().GetKey());
+		m_container.pop_back();
+	}
+
+	void clear()
+	{
+		WriteGuard guard(*this);
+		LogChange();
+		m_container.clear();
+	}
+
+	// Apply an arbitrary modification to the underlying container
+	template <typename Func>
+	auto modify(Func&& func)
+	{
+		WriteGuard guard(*this);
+		LogChange();
+		return func(m_container);
+	}
+
+	// Direct access to the container. Reading it without synchronization is only safe from the writer thread.
+	const container_type& writer_view() const
+	{
+		return m_container;
+	}
+
+	// Reader interface. These methods may be called from any thread.
+
+	// Copy the value having the specified key into result. Returns false if there is no such value.
+	bool find(key_type k, value_type& result) const
+	{
+		return OptimisticRead([k, &result](RawIter first, RawIter last, const ReadCheck&) {
+			return CopyIfFound(LowerBound(first, last, k), last, k, result);
+		});
+	}
+
+	// Like find(), but starts by checking the front value, which is the most common key to look up near the front.
+	// Otherwise it falls back to the binary search of find(), rather than galloping from the front or consulting
+	// the search index as InstrusiveSortedDeque::find_front() does. Quick keys are not returned, since they would be
+	// invalidated whenever the writer pops values from the front.
+	bool find_front(key_type k, value_type& result) const
+	{
+		return OptimisticRead([k, &result](RawIter first, RawIter last, const ReadCheck&) {
+			if ((first != last) && (first->GetKey() == k)) {
+				result = *first;
+				return true;
+			}
+
+			return CopyIfFound(LowerBound(first, last, k), last, k, result);
+		});
+	}
+
+	bool front(value_type& result) const
+	{
+		return OptimisticRead([&result](RawIter first, RawIter last, const ReadCheck&) {
+			if (first == last) {
+				return false;
+			}
+
+			result = *first;
+			return true;
+		});
+	}
+
+	bool back(value_type& result) const
+	{
+		return OptimisticRead([&result](RawIter first, RawIter last, const ReadCheck&) {
+			if (first == last) {
+				return false;
+			}
+
+			result = *(last - 1);
+			return true;
+		});
+	}
+
+	// Copy all the values with keys in the closed range [firstKey, lastKey] into result, replacing its contents.
+	// Returns the number of values copied.
+	size_type copy_range(key_type firstKey, key_type lastKey, std::vector<value_type>& result) const
+	{
+		return OptimisticRead([firstKey, lastKey, &result](RawIter first, RawIter last, const ReadCheck& unchanged) {
+			result.clear();
+			const size_type n = last - first;
+			RawIter it = LowerBound(first, last, firstKey);
+			for (size_type pos = it - first; (pos < n) && (it->GetKey() <= lastKey); ++pos, ++it) {
+				if ((0 == pos % READ_CHECK_INTERVAL) && ! unchanged()) {
+					break;
+				}
+
+				if (! it->IsDeleted()) {
+					result.push_back(*it);
+				}
+			}
+
+			return result.size();
+		});
+	}
+
+	// Returns an immutable snapshot of the live values. The snapshot is shared by all the readers which request it until
+	// the next modification, and holding it never delays the writer.
+	std::shared_ptr<const snapshot_type> snapshot() const
+	{
+		std::shared_ptr<const snapshot_type> pPrevious = std::atomic_load(&m_pLatestSnapshot);
+		if (pPrevious && (pPrevious->version() == version())) {
+			return pPrevious;
+		}
+
+		std::shared_ptr<const snapshot_type> pSnapshot = OptimisticRead([this, &pPrevious](RawIter first, RawIter last,
+																						   const ReadCheck& unchanged) {
+			const version_type current = m_version.load(std::memory_order_relaxed);
+			const bool bReuse = pPrevious && CanReuseSnapshot(pPrevious->version());
+			return snapshot_type::Build(first, last, current, bReuse ? pPrevious.get() : nullptr,
+										[this, &pPrevious](key_type firstKey, key_type lastKey) {
+											return HasChangedSince(pPrevious->version(), firstKey, lastKey);
+										},
+										unchanged);
+		});
+
+		// Publish the new snapshot, unless a later one has already been published
+		while ((! pPrevious || (pPrevious->version() < pSnapshot->version())) &&
+			   ! std::atomic_compare_exchange_weak(&m_pLatestSnapshot, &pPrevious, pSnapshot))
+		{
+		}
+
+		return pSnapshot;
+	}
+
+	// The size as of the last completed modification
+	size_type size() const
+	{
+		return m_size.load(std::memory_order_acquire);
+	}
+
+	bool empty() const
+	{
+		return 0 == size();
+	}
+
+	// The current version. An even version which remains unchanged indicates that the container has not been modified.
+	version_type version() const
+	{
+		return m_version.load(std::memory_order_acquire);
+	}
+
+private:
+	typedef std::deque<T, EpochDeferredAllocator<T> > StdDeque;
+	typedef typename StdDeque::const_iterator RawIter;
+
+	// Declared before the container, so that it is destroyed after it
+	mutable EpochReclaimer m_reclaimer;
+	container_type m_container;
+	std::atomic<version_type> m_version { 0 };
+	std::atomic<size_type> m_size { 0 };
+	mutable std::shared_ptr<const snapshot_type> m_pLatestSnapshot;
+
+	// A log of the most recent modifications other than appends at the back, used for reusing the segments of snapshots
+	struct ChangeLogEntry {
+		version_type m_version;
+		key_type m_key;
+		bool m_bAll;			// The entire container may have changed
+	};
+
+	enum { CHANGE_LOG_SIZE = 64 };
+	std::array<ChangeLogEntry, CHANGE_LOG_SIZE> m_changeLog;
+	std::atomic<std::uint64_t> m_nChanges { 0 };
+
+	class WriteGuard {
+		SeqLockSortedDeque& m_owner;
+	public:
+		explicit WriteGuard(SeqLockSortedDeque& owner)
+			: m_owner(owner)
+		{
+			const version_type v = m_owner.m_version.load(std::memory_order_relaxed);
+			assert(0 == (v & 1));
+			m_owner.m_version.store(v + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		~WriteGuard()
+		{
+			m_owner.m_size.store(m_owner.m_container.size(), std::memory_order_relaxed);
+			const version_type v = m_owner.m_version.load(std::memory_order_relaxed);
+			m_owner.m_version.store(v + 1, std::memory_order_release);
+			m_owner.m_reclaimer.OnWriteComplete();
+		}
+	};
+
+	// Tells a reader whether the container is still unmodified since its read began, so that reads of many values can
+	// stop as soon as they are torn, rather than only being retried once they are done
+	class ReadCheck {
+		const std::atomic<version_type>& m_version;
+		const version_type m_before;
+	public:
+		ReadCheck(const std::atomic<version_type>& version, version_type before)
+			: m_version(version)
+			, m_before(before)
+		{
+		}
+
+		bool operator()() const
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return m_version.load(std::memory_order_relaxed) == m_before;
+		}
+	};
+
+	// The number of values which readers copy between checks of the version
+	enum { READ_CHECK_INTERVAL = 64 };
+
+	// Invokes func(first, last, unchanged) with a pair of raw iterators spanning the container, which were read while it
+	// was not being modified, and a ReadCheck. The iterators may only be moved within [first, last), by position, since
+	// comparing them with last is not reliable once the container is modified. The result is only returned if the
+	// container remained unmodified until func returned, otherwise the read is retried.
+	template <typename Func>
+	auto OptimisticRead(Func&& func) const
+	{
+		const unsigned epoch = m_reclaimer.EnterRead();
+		for (;;) {
+			const version_type before = m_version.load(std::memory_order_acquire);
+			if (BOOST_UNLIKELY(before & 1)) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			const StdDeque& raw = m_container;
+			const RawIter first = raw.begin();
+			const RawIter last = raw.end();
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (BOOST_UNLIKELY(m_version.load(std::memory_order_relaxed) != before)) {
+				continue;
+			}
+
+			auto result = func(first, last, ReadCheck(m_version, before));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (BOOST_LIKELY(m_version.load(std::memory_order_relaxed) == before)) {
+				m_reclaimer.ExitRead(epoch);
+				return result;
+			}
+		}
+	}
+
+	void LogChange(key_type k, bool bAll = false)
+	{
+		const std::uint64_t n = m_nChanges.load(std::memory_order_relaxed);
+		m_changeLog[n % CHANGE_LOG_SIZE] = ChangeLogEntry{ m_version.load(std::memory_order_relaxed), k, bAll };
+		m_nChanges.store(n + 1, std::memory_order_relaxed);
+	}
+
+	void LogChange()
+	{
+		LogChange(key_type(), true);
+	}
+
+	// Checks that all the changes since the specified version are still in the log and are not global changes.
+	// Called by readers from within OptimisticRead().
+	bool CanReuseSnapshot(version_type since) const
+	{
+		const std::uint64_t n = m_nChanges.load(std::memory_order_relaxed);
+		for (std::uint64_t i = n; i > 0; --i) {
+			const ChangeLogEntry& entry = m_changeLog[(i - 1) % CHANGE_LOG_SIZE];
+			if (entry.m_version < since) {
+				return true;
+			}
+
+			if (entry.m_bAll || (n - i + 1 == CHANGE_LOG_SIZE)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool HasChangedSince(version_type since, key_type firstKey, key_type lastKey) const
+	{
+		const std::uint64_t n = m_nChanges.load(std::memory_order_relaxed);
+		for (std::uint64_t i = n; (i > 0) && (n - i < CHANGE_LOG_SIZE); --i) {
+			const ChangeLogEntry& entry = m_changeLog[(i - 1) % CHANGE_LOG_SIZE];
+			if (entry.m_version < since) {
+				break;
+			}
+
+			if ((firstKey <= entry.m_key) && (entry.m_key <= lastKey)) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static RawIter LowerBound(RawIter first, RawIter last, key_type k)
+	{
+		const auto FindComp = [](const T& value, key_type k)->bool { return value.GetKey() < k; };
+		return std::lower_bound(first, last, k, FindComp);
+	}
+
+	static bool CopyIfFound(RawIter it, RawIter last, key_type k, value_type& result)
+	{
+		if ((it == last) || (it->GetKey() != k) || it->IsDeleted()) {
+			return false;
+		}
+
+		result = *it;
+		return true;
+	}
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_SEQLOCKSORTEDDEQUE_H_ */
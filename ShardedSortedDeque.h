@@ -0,0 +1,217 @@
+/*
+ * ShardedSortedDeque.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SHARDEDSORTEDDEQUE_H_
+#define UTILS_SHARDEDSORTEDDEQUE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+#include "IntrusiveSortedDeque.h"
+
+namespace Utils {
+
+// ShardedSortedDeque: Partitions the key space into contiguous ranges, each held by a separate InstrusiveSortedDeque
+// with its own lock, so that threads which insert or remove values in different ranges proceed in parallel.
+// The ranges are defined by a sorted list of split keys: Shard i holds the keys in [split[i-1], split[i]).
+// Since the shards are ordered by key, iterating over them in order visits all the values in ascending order.
+// A shard may also be owned by a single worker thread, which accesses it via with_shard() without contention.
+
+template <typename T>
+class ShardedSortedDeque {
+public:
+	typedef InstrusiveSortedDeque<T> shard_type;
+	typedef typename shard_type::key_type key_type;
+	typedef typename shard_type::size_type size_type;
+	typedef T value_type;
+
+	explicit ShardedSortedDeque(std::vector<key_type> splitKeys)
+		: m_splitKeys(std::move(splitKeys))
+		, m_shards(m_splitKeys.size() + 1)
+	{
+		assert(std::is_sorted(m_splitKeys.begin(), m_splitKeys.end()));
+	}
+
+	ShardedSortedDeque(const ShardedSortedDeque&) = delete;
+	ShardedSortedDeque& operator=(const ShardedSortedDeque&) = delete;
+
+	size_type shard_count() const
+	{
+		return m_shards.size();
+	}
+
+	// The index of the shard holding the specified key
+	size_type shard_index(key_type k) const
+	{
+		return std::upper_bound(m_splitKeys.begin(), m_splitKeys.end(), k) - m_splitKeys.begin();
+	}
+
+	// Thread-safe methods, which lock the shard holding the relevant key
+
+	template< typename... Args >
+	void emplace_back(Args&&... args)
+	{
+		T value(std::forward<Args>(args)...);
+		Shard& shard = m_shards[shard_index(value.GetKey())];
+		std::lock_guard<std::mutex> lock(shard.m_mutex);
+		shard.m_deque.emplace_back(std::move(value));
+	}
+
+	bool erase(key_type k)
+	{
+		Shard& shard = m_shards[shard_index(k)];
+		std::lock_guard<std::mutex> lock(shard.m_mutex);
+		return shard.m_deque.erase(k);
+	}
+
+	// Copy the value having the specified key into result. Returns false if there is no such value.
+	bool find(key_type k, value_type& result) const
+	{
+		const Shard& shard = m_shards[shard_index(k)];
+		std::lock_guard<std::mutex> lock(shard.m_mutex);
+		if (shard.m_deque.empty()) {
+			return false;
+		}
+
+		const auto it = shard.m_deque.find(k);
+		if (it == shard.m_deque.end()) {
+			return false;
+		}
+
+		result = *it;
+		return true;
+	}
+
+	// Invoke func with the shard holding the specified key, while holding its lock
+	template <typename Func>
+	auto with_shard_of(key_type k, Func&& func)
+	{
+		return with_shard(shard_index(k), std::forward<Func>(func));
+	}
+
+	// Invoke func with the specified shard, while holding its lock
+	template <typename Func>
+	auto with_shard(size_type index, Func&& func)
+	{
+		Shard& shard = m_shards.at(index);
+		std::lock_guard<std::mutex> lock(shard.m_mutex);
+		return func(shard.m_deque);
+	}
+
+	size_type size() const
+	{
+		size_type total = 0;
+		for (const Shard& shard : m_shards) {
+			std::lock_guard<std::mutex> lock(shard.m_mutex);
+			total += shard.m_deque.size();
+		}
+
+		return total;
+	}
+
+	void clear()
+	{
+		for (Shard& shard : m_shards) {
+			std::lock_guard<std::mutex> lock(shard.m_mutex);
+			shard.m_deque.clear();
+		}
+	}
+
+	// Invoke func on all the values in ascending order of their keys, locking one shard at a time
+	template <typename Func>
+	void for_each(Func&& func) const
+	{
+		for (const Shard& shard : m_shards) {
+			std::lock_guard<std::mutex> lock(shard.m_mutex);
+			if (! shard.m_deque.empty()) {
+				std::for_each(shard.m_deque.begin(), shard.m_deque.end(), func);
+			}
+		}
+	}
+
+	// An iterator over the values of all the shards in ascending order.
+	// Iterators do not lock the shards, so they should only be used while no other thread modifies the container.
+	class const_iterator : public boost::iterator_facade<const_iterator, const T, std::forward_iterator_tag> {
+		friend class ShardedSortedDeque;
+		friend class boost::iterator_core_access;
+
+		typedef typename shard_type::const_iterator ShardIter;
+
+		const ShardedSortedDeque* m_pOwner = nullptr;
+		size_type m_shard = 0;
+		ShardIter m_it;
+
+		const_iterator(const ShardedSortedDeque* pOwner, size_type shard)
+			: m_pOwner(pOwner)
+			, m_shard(shard)
+		{
+			SkipEmptyShards();
+		}
+
+		const T& dereference() const { return *m_it; }
+
+		bool equal(const const_iterator& other) const
+		{
+			return (m_shard == other.m_shard) && ((m_shard == m_pOwner->m_shards.size()) || (m_it == other.m_it));
+		}
+
+		void increment()
+		{
+			if (++m_it == m_pOwner->m_shards[m_shard].m_deque.end()) {
+				++m_shard;
+				SkipEmptyShards();
+			}
+		}
+
+		void SkipEmptyShards()
+		{
+			const auto& shards = m_pOwner->m_shards;
+			while ((m_shard < shards.size()) && shards[m_shard].m_deque.empty()) {
+				++m_shard;
+			}
+
+			if (m_shard < shards.size()) {
+				m_it = shards[m_shard].m_deque.begin();
+			}
+		}
+
+	public:
+		const_iterator() = default;
+	};
+
+	const_iterator begin() const
+	{
+		return const_iterator(this, 0);
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator(this, m_shards.size());
+	}
+
+private:
+	enum { CACHE_LINE_SIZE = 64 };
+
+	// Aligned to a cache line so that threads working on adjacent shards don't contend
+	struct alignas(CACHE_LINE_SIZE) Shard {
+		mutable std::mutex m_mutex;
+		shard_type m_deque;
+	};
+
+	const std::vector<key_type> m_splitKeys;
+	std::vector<Shard> m_shards;
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_SHARDEDSORTEDDEQUE_H_ */
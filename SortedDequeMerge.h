@@ -0,0 +1,186 @@
+/*
+ * SortedDequeMerge.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUEMERGE_H_
+#define UTILS_SORTEDDEQUEMERGE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+namespace Utils {
+
+// SortedDequeMerge: A read-only view of the union of several InstrusiveSortedDeque containers in key order, as defined by their Compare.
+// The iterator keeps a cursor into each non-exhausted container in a binary min-heap ordered by key, so advancing it costs
+// O(log(k)) for k containers. Deleted values are skipped by the containers' own iterators.
+// Values with equal keys in several containers are visited in the order in which the containers were given.
+// The containers should not be modified while the view's iterators are in use.
+
+template <typename Container>
+class SortedDequeMerge {
+public:
+	typedef typename Container::key_type key_type;
+	typedef typename Container::value_type value_type;
+	typedef std::size_t size_type;
+
+	explicit SortedDequeMerge(std::vector<const Container*> sources)
+		: m_sources(std::move(sources))
+	{
+	}
+
+	class const_iterator : public boost::iterator_facade<const_iterator, const value_type, std::forward_iterator_tag> {
+		friend class SortedDequeMerge;
+		friend class boost::iterator_core_access;
+
+		typedef typename Container::const_iterator SourceIter;
+
+		struct Cursor {
+			SourceIter m_it;
+			SourceIter m_end;
+			size_type m_source;
+
+			bool operator<(const Cursor& other) const
+			{
+				typename Container::key_extractor keyOf;
+				const key_type k = keyOf(*m_it);
+				const key_type otherKey = keyOf(*other.m_it);
+				typename Container::key_compare comp;
+				return comp(k, otherKey) || (! comp(otherKey, k) && (m_source < other.m_source));
+			}
+		};
+
+		// A min-heap of the cursors by their current keys
+		std::vector<Cursor> m_heap;
+
+		void Add(SourceIter it, SourceIter end, size_type source)
+		{
+			if (it != end) {
+				m_heap.push_back(Cursor{ std::move(it), std::move(end), source });
+				SiftUp(m_heap.size() - 1);
+			}
+		}
+
+		const value_type& dereference() const { return *m_heap.front().m_it; }
+
+		bool equal(const const_iterator& other) const
+		{
+			if (m_heap.empty() || other.m_heap.empty()) {
+				return m_heap.empty() && other.m_heap.empty();
+			}
+
+			return (m_heap.front().m_source == other.m_heap.front().m_source) && (m_heap.front().m_it == other.m_heap.front().m_it);
+		}
+
+		void increment()
+		{
+			Cursor& top = m_heap.front();
+			if (++top.m_it == top.m_end) {
+				top = std::move(m_heap.back());
+				m_heap.pop_back();
+			}
+
+			if (! m_heap.empty()) {
+				SiftDown(0);
+			}
+		}
+
+		void SiftUp(size_type i)
+		{
+			while (i > 0) {
+				const size_type parent = (i - 1) / 2;
+				if (! (m_heap[i] < m_heap[parent])) {
+					break;
+				}
+
+				std::swap(m_heap[i], m_heap[parent]);
+				i = parent;
+			}
+		}
+
+		void SiftDown(size_type i)
+		{
+			const size_type n = m_heap.size();
+			for (;;) {
+				size_type smallest = i;
+				const size_type left = 2 * i + 1;
+				const size_type right = left + 1;
+				if ((left < n) && (m_heap[left] < m_heap[smallest])) {
+					smallest = left;
+				}
+
+				if ((right < n) && (m_heap[right] < m_heap[smallest])) {
+					smallest = right;
+				}
+
+				if (smallest == i) {
+					break;
+				}
+
+				std::swap(m_heap[i], m_heap[smallest]);
+				i = smallest;
+			}
+		}
+
+	public:
+		const_iterator() = default;
+
+		// The index of the container holding the current value
+		size_type source_index() const
+		{
+			return m_heap.front().m_source;
+		}
+	};
+
+	const_iterator begin() const
+	{
+		const_iterator result;
+		result.m_heap.reserve(m_sources.size());
+		for (size_type i = 0; i < m_sources.size(); ++i) {
+			const Container& source = *m_sources[i];
+			if (! source.empty()) {
+				result.Add(source.begin(), source.end(), i);
+			}
+		}
+
+		return result;
+	}
+
+	const_iterator end() const
+	{
+		return const_iterator();
+	}
+
+	// Returns an iterator to the first value whose key is not less than k, using each container's lower_bound()
+	const_iterator seek(key_type k) const
+	{
+		const_iterator result;
+		result.m_heap.reserve(m_sources.size());
+		for (size_type i = 0; i < m_sources.size(); ++i) {
+			const Container& source = *m_sources[i];
+			if (! source.empty()) {
+				result.Add(source.lower_bound(k), source.end(), i);
+			}
+		}
+
+		return result;
+	}
+
+	size_type source_count() const
+	{
+		return m_sources.size();
+	}
+
+private:
+	std::vector<const Container*> m_sources;
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUEMERGE_H_ */
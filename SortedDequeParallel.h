@@ -0,0 +1,370 @@
+/*
+ * SortedDequeParallel.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUEPARALLEL_H_
+#define UTILS_SORTEDDEQUEPARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "IntrusiveSortedDeque.h"
+#include "SortedDequeTombstones.h"
+
+// Parallel algorithms over the live values of an InstrusiveSortedDeque, or of any container of its kind.
+// The positions of the values are divided into chunks of a fixed number of positions, counted from the start of the
+// range, which are run as separate tasks by an executor. Each task passes its chunk to for_each_segment_at(), which
+// splits it into the contiguous segments of at most SEGMENT_SIZE values. The chunks aren't aligned to the blocks of
+// the deque, so the segments at the edges of a chunk may be shorter. An executor is any callable which may be invoked as executor(nTasks, task), and runs
+// task(i) for all i in [0, nTasks), in any order and on any threads, returning once all of them have completed.
+// The default executor is a process-wide SortedDequeThreadPool. Containers may also be filled from unsorted values by
+// sorting them in parallel.
+// The container must not be modified while an algorithm runs, and the functions passed to the algorithms must not throw.
+
+namespace Utils {
+
+// SortedDequeThreadPool: A fixed set of worker threads, which run the tasks of one call at a time, together with the
+// calling thread. The tasks are claimed one by one from a shared counter, so that threads which complete their tasks
+// early go on to take the remaining ones. Concurrent calls are run one after the other.
+// The tasks must not call the pool which runs them, since the nested call would wait for the call which is running
+// the task to complete, and so deadlock. This is asserted.
+
+class SortedDequeThreadPool {
+public:
+	// The calling thread also runs tasks, so nThreads - 1 workers are started
+	explicit SortedDequeThreadPool(unsigned nThreads = std::thread::hardware_concurrency())
+	{
+		for (unsigned i = 1; i < nThreads; ++i) {
+			m_workers.emplace_back([this] { WorkerLoop(); });
+		}
+	}
+
+	SortedDequeThreadPool(const SortedDequeThreadPool&) = delete;
+	SortedDequeThreadPool& operator=(const SortedDequeThreadPool&) = delete;
+
+	~SortedDequeThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+
+		m_wake.notify_all();
+		for (std::thread& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	template <typename Task>
+	void operator()(std::size_t nTasks, Task&& task)
+	{
+		assert(RunningPool() != this);
+		if (m_workers.empty() || (nTasks < 2)) {
+			for (std::size_t i = 0; i < nTasks; ++i) {
+				task(i);
+			}
+
+			return;
+		}
+
+		const std::function<void(std::size_t)> job(std::ref(task));
+		std::lock_guard<std::mutex> callLock(m_callMutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = &job;
+			m_nTasks = nTasks;
+			m_nextTask = 0;
+			m_nBusyWorkers = m_workers.size();
+			++m_generation;
+		}
+
+		m_wake.notify_all();
+		RunTasks(job);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return 0 == m_nBusyWorkers; });
+		m_job = nullptr;
+	}
+
+	// The number of threads running the tasks, including the calling thread
+	unsigned size() const
+	{
+		return static_cast<unsigned>(m_workers.size() + 1);
+	}
+
+	static SortedDequeThreadPool& instance()
+	{
+		static SortedDequeThreadPool pool;
+		return pool;
+	}
+
+private:
+	std::vector<std::thread> m_workers;
+	std::mutex m_callMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	const std::function<void(std::size_t)>* m_job = nullptr;
+	std::size_t m_nTasks = 0;
+	std::atomic<std::size_t> m_nextTask { 0 };
+	std::size_t m_nBusyWorkers = 0;
+	std::uint64_t m_generation = 0;
+	bool m_stop = false;
+
+	// The pool whose tasks the current thread is running, if any
+	static const SortedDequeThreadPool*& RunningPool()
+	{
+		static thread_local const SortedDequeThreadPool* pool = nullptr;
+		return pool;
+	}
+
+	void RunTasks(const std::function<void(std::size_t)>& job)
+	{
+		const SortedDequeThreadPool* const outerPool = std::exchange(RunningPool(), this);
+		for (std::size_t i = m_nextTask++; i < m_nTasks; i = m_nextTask++) {
+			job(i);
+		}
+
+		RunningPool() = outerPool;
+	}
+
+	void WorkerLoop()
+	{
+		std::uint64_t generation = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;) {
+			m_wake.wait(lock, [&] { return m_stop || (m_generation != generation); });
+			if (m_stop) {
+				return;
+			}
+
+			generation = m_generation;
+			const std::function<void(std::size_t)>& job = *m_job;
+			lock.unlock();
+			RunTasks(job);
+			lock.lock();
+			if (0 == --m_nBusyWorkers) {
+				m_done.notify_one();
+			}
+		}
+	}
+};
+
+namespace ParallelDetail {
+
+// The size of each chunk in full segments, which is large enough for the cost of running a task to be negligible
+constexpr std::size_t CHUNK_SEGMENTS = 64;
+
+// The number of positions in each chunk, which is 4096 for the SEGMENT_SIZE of InstrusiveSortedDeque
+template <typename Container>
+constexpr std::size_t ChunkSize()
+{
+	return CHUNK_SEGMENTS * static_cast<std::size_t>(Container::SEGMENT_SIZE);
+}
+
+// Invokes func on each live value of a segment, with a plain loop over segments which have no deleted values
+template <typename Value, typename Func>
+void ForEachLive(Value* values, std::size_t n, std::uint64_t liveMask, Func&& func)
+{
+	if (liveMask == (n == 64 ? ~std::uint64_t(0) : ((std::uint64_t(1) << n) - 1))) {
+		for (std::size_t i = 0; i < n; ++i) {
+			func(values[i]);
+		}
+
+		return;
+	}
+
+	for (; liveMask != 0; liveMask &= liveMask - 1) {
+		func(values[TombstonesDetail::CountTrailingZeros(liveMask)]);
+	}
+}
+
+// The number of chunks which the positions [first, last) are divided into
+template <typename Container>
+std::size_t ChunkCount(std::size_t first, std::size_t last)
+{
+	return (last - first + ChunkSize<Container>() - 1) / ChunkSize<Container>();
+}
+
+// Runs chunkFunc(i, chunkFirst, chunkLast) on each chunk i of the positions [first, last) of the container
+template <typename Container, typename ChunkFunc, typename Executor>
+void ForEachChunk(std::size_t first, std::size_t last, ChunkFunc&& chunkFunc, Executor&& executor)
+{
+	const std::size_t chunkSize = ChunkSize<Container>();
+	executor(ChunkCount<Container>(first, last), [&](std::size_t i) {
+		const std::size_t chunkFirst = first + i * chunkSize;
+		chunkFunc(i, chunkFirst, std::min(last, chunkFirst + chunkSize));
+	});
+}
+
+template <typename Container, typename Func, typename Executor>
+void ForEachPositions(Container& container, std::size_t first, std::size_t last, Func& func, Executor&& executor)
+{
+	ForEachChunk<Container>(first, last, [&](std::size_t, std::size_t chunkFirst, std::size_t chunkLast) {
+		container.for_each_segment_at(chunkFirst, chunkLast, [&](auto* values, std::size_t n, std::uint64_t liveMask) {
+			ForEachLive(values, n, liveMask, func);
+		});
+	}, executor);
+}
+
+// Reduces each chunk separately, starting from init, and then the results of the chunks in order, so that reduce
+// need only be associative
+template <typename Container, typename T, typename Map, typename Reduce, typename Executor>
+T ReducePositions(Container& container, std::size_t first, std::size_t last, T init, Map& map, Reduce& reduce,
+				  Executor&& executor)
+{
+	std::vector<T> partials(ChunkCount<Container>(first, last), init);
+	ForEachChunk<Container>(first, last, [&](std::size_t i, std::size_t chunkFirst, std::size_t chunkLast) {
+		T partial = init;
+		container.for_each_segment_at(chunkFirst, chunkLast, [&](auto* values, std::size_t n, std::uint64_t liveMask) {
+			ForEachLive(values, n, liveMask, [&](auto& value) { partial = reduce(std::move(partial), map(value)); });
+		});
+
+		partials[i] = std::move(partial);
+	}, executor);
+
+	for (T& partial : partials) {
+		init = reduce(std::move(init), std::move(partial));
+	}
+
+	return init;
+}
+
+// The minimal number of values in each of the runs which ParallelStableSort() sorts separately
+enum { MIN_SORT_RUN = 4096 };
+
+// Sorts runs of the values in parallel, one for each hardware thread, and then merges pairs of adjacent runs in
+// parallel, in rounds which halve the number of runs, alternating between the values and a buffer of the same size.
+// The merges take values from the earlier run first, so that the sort is stable.
+template <typename T, typename Less, typename Executor>
+void ParallelStableSort(std::vector<T>& values, Less less, Executor& executor)
+{
+	const std::size_t nThreads = std::max(1u, std::thread::hardware_concurrency());
+	const std::size_t nRuns = std::max<std::size_t>(1, std::min<std::size_t>(nThreads, values.size() / MIN_SORT_RUN));
+	std::vector<std::size_t> bounds;
+	for (std::size_t i = 0; i <= nRuns; ++i) {
+		bounds.push_back(values.size() * i / nRuns);
+	}
+
+	executor(nRuns, [&](std::size_t i) {
+		std::stable_sort(values.begin() + bounds[i], values.begin() + bounds[i + 1], less);
+	});
+
+	if (nRuns == 1) {
+		return;
+	}
+
+	std::vector<T> buffer(values.size());
+	std::vector<T>* from = &values;
+	std::vector<T>* to = &buffer;
+	while (bounds.size() > 2) {
+		const std::size_t nCurrentRuns = bounds.size() - 1;
+		executor((nCurrentRuns + 1) / 2, [&](std::size_t i) {
+			const auto source = std::make_move_iterator(from->begin());
+			const std::size_t lo = bounds[2 * i];
+			const std::size_t mid = bounds[std::min(2 * i + 1, nCurrentRuns)];
+			const std::size_t hi = bounds[std::min(2 * i + 2, nCurrentRuns)];
+			std::merge(source + lo, source + mid, source + mid, source + hi, to->begin() + lo, less);
+		});
+
+		std::vector<std::size_t> merged;
+		for (std::size_t i = 0; i < nCurrentRuns; i += 2) {
+			merged.push_back(bounds[i]);
+		}
+
+		merged.push_back(bounds.back());
+		bounds.swap(merged);
+		std::swap(from, to);
+	}
+
+	if (from != &values) {
+		values.swap(buffer);
+	}
+}
+
+}	// namespace ParallelDetail
+
+// Invokes func(value) on the live values whose keys are in the range [lo, hi), concurrently on several threads.
+// The values are passed as non-const references if the container is not const.
+template <typename Container, typename Func, typename Executor = SortedDequeThreadPool&>
+void parallel_for_each(Container& container, const typename Container::key_type& lo, const typename Container::key_type& hi,
+					   Func func, Executor&& executor = SortedDequeThreadPool::instance())
+{
+	const std::size_t first = container.lower_bound(lo).position();
+	const std::size_t last = std::max(first, container.lower_bound(hi).position());
+	ParallelDetail::ForEachPositions(container, first, last, func, executor);
+}
+
+// Invokes func on all the live values, using the default executor
+template <typename Container, typename Func>
+void parallel_for_each(Container& container, Func func)
+{
+	ParallelDetail::ForEachPositions(container, 0, container.capacity(), func, SortedDequeThreadPool::instance());
+}
+
+// Returns the reduction by reduce(accumulated, mapped) of map(value) over the live values whose keys are in the
+// range [lo, hi), as std::transform_reduce() does. init should be the identity of reduce, since the result of each
+// chunk is reduced starting from it, and reduce should be associative, since the values are grouped by chunk.
+template <typename Container, typename T, typename Map, typename Reduce = std::plus<T>, typename Executor = SortedDequeThreadPool&>
+T parallel_reduce(Container& container, const typename Container::key_type& lo, const typename Container::key_type& hi,
+				  T init, Map map, Reduce reduce = Reduce(), Executor&& executor = SortedDequeThreadPool::instance())
+{
+	const std::size_t first = container.lower_bound(lo).position();
+	const std::size_t last = std::max(first, container.lower_bound(hi).position());
+	return ParallelDetail::ReducePositions(container, first, last, std::move(init), map, reduce, executor);
+}
+
+// The reduction over all the live values, using the default executor
+template <typename Container, typename T, typename Map, typename Reduce = std::plus<T>>
+T parallel_reduce(Container& container, T init, Map map, Reduce reduce = Reduce())
+{
+	return ParallelDetail::ReducePositions(container, 0, container.capacity(), std::move(init), map, reduce,
+										   SortedDequeThreadPool::instance());
+}
+
+// Replaces the values of the container by those in [first, last), which may be in any order, sorting them in parallel.
+// Of the values with equal keys, the last one in the range is kept, and if it's deleted the key is left out, as though
+// the values were replayed in order. The sorted values are then moved into the deque, and its search index is built,
+// in a single pass, rather than inserting each value which is out of order in the middle, as emplace_back() would.
+template <typename Container, typename InputIt, typename Executor = SortedDequeThreadPool&>
+void parallel_assign_unsorted(Container& container, InputIt first, InputIt last,
+							  Executor&& executor = SortedDequeThreadPool::instance())
+{
+	typedef typename Container::value_type T;
+	const typename Container::key_compare comp = container.key_comp();
+	const typename Container::key_extractor keyOf = typename Container::key_extractor();
+	std::vector<T> values(first, last);
+	ParallelDetail::ParallelStableSort(values, [&](const T& a, const T& b) { return comp(keyOf(a), keyOf(b)); }, executor);
+
+	std::size_t nUnique = 0;
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		if ((i + 1 < values.size()) && ! comp(keyOf(values[i]), keyOf(values[i + 1]))) {
+			continue;
+		}
+
+		if (nUnique != i) {
+			values[nUnique] = std::move(values[i]);
+		}
+
+		++nUnique;
+	}
+
+	container.assign(std::make_move_iterator(values.begin()), std::make_move_iterator(values.begin() + nUnique));
+}
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUEPARALLEL_H_ */
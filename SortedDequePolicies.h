@@ -0,0 +1,110 @@
+/*
+ * SortedDequePolicies.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUEPOLICIES_H_
+#define UTILS_SORTEDDEQUEPOLICIES_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "IntrusiveSortedDeque.h"
+
+// Compaction and statistics policies which may be used as the Compaction and Stats template arguments of
+// InstrusiveSortedDeque, and a bundle of all of its policies, for selecting them by name rather than by position.
+// See NoCompaction and NoStats in IntrusiveSortedDeque.h for the interfaces which the policies implement.
+
+namespace Utils {
+
+// RatioCompaction: Compacts the deque once the deleted values make up more than NUMERATOR / DENOMINATOR of it,
+// and it holds at least MIN_CAPACITY values, so that searches and iteration don't slow down as deleted values
+// accumulate in the middle. Since each compaction removes at least a fixed fraction of the values, its cost
+// is amortized over the removals which preceded it.
+
+template <std::size_t NUMERATOR = 1, std::size_t DENOMINATOR = 2, std::size_t MIN_CAPACITY = 64>
+struct RatioCompaction {
+	static_assert((NUMERATOR > 0) && (NUMERATOR < DENOMINATOR), "The ratio should be between 0 and 1");
+
+	template <typename SizeType>
+	constexpr bool ShouldCompact(SizeType capacity, SizeType nDeleted) const
+	{
+		return (capacity >= MIN_CAPACITY) && (nDeleted * DENOMINATOR > capacity * NUMERATOR);
+	}
+};
+
+// CountingStats: Counts the operations, for comparing the behavior of the other policies under a given workload
+class CountingStats {
+public:
+	typedef std::size_t size_type;
+
+	void OnFind(bool found)
+	{
+		++m_nFinds;
+		m_nFound += found;
+	}
+
+	void OnErase(size_type n) { m_nErased += n; }
+
+	void OnTrim(size_type n) { m_nTrimmed += n; }
+
+	void OnCompact(size_type n)
+	{
+		++m_nCompactions;
+		m_nCompacted += n;
+	}
+
+	size_type finds() const { return m_nFinds; }
+	size_type found() const { return m_nFound; }
+	size_type erased() const { return m_nErased; }
+	size_type trimmed() const { return m_nTrimmed; }
+	size_type compactions() const { return m_nCompactions; }
+	size_type compacted() const { return m_nCompacted; }
+
+	void reset()
+	{
+		*this = CountingStats();
+	}
+
+private:
+	size_type m_nFinds = 0;
+	size_type m_nFound = 0;
+	size_type m_nErased = 0;
+	size_type m_nTrimmed = 0;
+	size_type m_nCompactions = 0;
+	size_type m_nCompacted = 0;
+};
+
+// SortedDequePolicies: The default policies of InstrusiveSortedDeque, apart from the key extractor, which may be given
+// for values which don't define KeyType. The default key_compare orders the keys defined by key_extractor ascending,
+// even where key_extractor is redefined. Other combinations are defined by deriving from it and redefining some of
+// the types, for example:
+//		struct HashedPolicies : SortedDequePolicies<Value> {
+//			typedef HashSearchIndex<Value::KeyType> search_index;
+//		};
+//		PolicySortedDeque<Value, HashedPolicies> container;
+
+template <typename T, typename KeyOf = IntrusiveKeyOf>
+struct SortedDequePolicies {
+	typedef std::allocator<T> allocator_type;					// The storage of the underlying deque
+	typedef NoSearchIndex search_index;
+	typedef BinarySearchPolicy search_policy;
+	typedef KeyOf key_extractor;
+	typedef DefaultKeyCompare key_compare;
+	typedef IntrusiveTombstones tombstones;
+	typedef NoCompaction compaction;
+	typedef NoStats stats;
+};
+
+template <typename T, typename Policies = SortedDequePolicies<T>>
+using PolicySortedDeque = InstrusiveSortedDeque<T, typename Policies::allocator_type, typename Policies::search_index,
+												typename Policies::search_policy, typename Policies::key_compare,
+												typename Policies::tombstones, typename Policies::key_extractor,
+												typename Policies::compaction, typename Policies::stats>;
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUEPOLICIES_H_ */
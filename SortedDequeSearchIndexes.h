@@ -0,0 +1,955 @@
+/*
+ * SortedDequeSearchIndexes.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUESEARCHINDEXES_H_
+#define UTILS_SORTEDDEQUESEARCHINDEXES_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <boost/config.hpp>
+
+#include "IntrusiveSortedDeque.h"
+
+// Search indexes which may be used as the SearchIndex template argument of InstrusiveSortedDeque.
+// See NoSearchIndex in IntrusiveSortedDeque.h for the interface which they implement.
+
+namespace Utils {
+
+namespace SearchIndexDetail {
+
+inline void Prefetch(const void* p)
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(p);
+#else
+	(void) p;
+#endif
+}
+
+}	// namespace SearchIndexDetail
+
+// EytzingerSearchIndex: Samples the key of every SAMPLE_STRIDE'th position, and keeps the samples in Eytzinger (BFS) order,
+// so that a search descends through the samples using a few cache lines, which are prefetched ahead of the comparisons.
+// The search over the samples narrows the search over the values to SAMPLE_STRIDE positions.
+// Sample positions are absolute, so that removing values from the front only advances the position of the front.
+// Samples appended at the back are kept in a sorted tail, which is merged into the Eytzinger layout once it grows as
+// large as the part already laid out, so that the amortized cost of appending remains constant.
+// Compare must match the Compare of the container.
+
+template <typename KeyType, std::size_t SAMPLE_STRIDE = 16, typename Compare = std::less<KeyType>>
+class EytzingerSearchIndex {
+public:
+	typedef std::size_t size_type;
+
+	template <typename Keys>
+	void OnPushBack(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY(keys.size() != m_nKnownSize + 1)) {
+			OnReset(keys);
+			return;
+		}
+
+		const size_type pos = m_frontPos + m_nKnownSize;
+		++m_nKnownSize;
+		if (0 == pos % SAMPLE_STRIDE) {
+			if (m_samples.empty()) {
+				m_firstSamplePos = pos;
+			}
+
+			assert(SamplePos(m_samples.size()) == pos);
+			m_samples.push_back(keys[keys.size() - 1]);
+			if (m_samples.size() - m_nLaidOut > std::max<size_type>(m_nLaidOut, MIN_TAIL_SIZE)) {
+				LayOut();
+			}
+		}
+	}
+
+	template <typename Keys>
+	void OnPushFront(const Keys& keys)
+	{
+		OnReset(keys);
+	}
+
+	template <typename Keys>
+	void OnPopFront(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_frontPos += n;
+		m_nKnownSize -= n;
+
+		// Samples of removed values are still valid lower bounds, so they are only dropped once they are the majority
+		if (NumStaleSamples() > m_samples.size() / 2) {
+			const size_type nStale = NumStaleSamples();
+			m_samples.erase(m_samples.begin(), m_samples.begin() + nStale);
+			m_firstSamplePos += nStale * SAMPLE_STRIDE;
+			LayOut();
+		}
+	}
+
+	template <typename Keys>
+	void OnPopBack(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_nKnownSize -= n;
+		const size_type endPos = m_frontPos + m_nKnownSize;
+		while (! m_samples.empty() && (SamplePos(m_samples.size() - 1) >= endPos)) {
+			m_samples.pop_back();
+		}
+
+		if (m_samples.size() < m_nLaidOut) {
+			LayOut();
+		}
+	}
+
+	template <typename Keys>
+	void OnReset(const Keys& keys)
+	{
+		m_frontPos = 0;
+		m_firstSamplePos = 0;
+		m_nKnownSize = keys.size();
+		m_samples.clear();
+		for (size_type i = 0; i < m_nKnownSize; i += SAMPLE_STRIDE) {
+			m_samples.push_back(keys[i]);
+		}
+
+		LayOut();
+	}
+
+	template <typename Keys, typename SizeType>
+	constexpr SearchIndexLookup Lookup(const Keys&, const KeyType&, SizeType&) const
+	{
+		return SEARCH_INDEX_UNKNOWN;
+	}
+
+	template <typename Keys, typename SizeType>
+	bool Narrow(const Keys& keys, const KeyType& k, SizeType& lo, SizeType& hi) const
+	{
+		if (BOOST_UNLIKELY((keys.size() != m_nKnownSize) || m_samples.empty())) {
+			return false;
+		}
+
+		// The lower bound is after the last sample which is less than k, and not after the first one which isn't
+		const size_type endPos = m_frontPos + m_nKnownSize;
+		const size_type j = SampleLowerBound(k);
+		const size_type loPos = (0 == j) ? m_frontPos : std::max(SamplePos(j - 1) + 1, m_frontPos);
+		const size_type hiPos = (m_samples.size() == j) ? endPos : std::max(SamplePos(j) + 1, m_frontPos);
+		lo = loPos - m_frontPos;
+		hi = std::max(loPos, hiPos) - m_frontPos;
+		return true;
+	}
+
+private:
+	enum { MIN_TAIL_SIZE = 8, PREFETCH_LEVELS = 4 };
+
+	size_type m_frontPos = 0;				// The absolute position of the front
+	size_type m_nKnownSize = 0;				// The size of the deque as last notified
+	size_type m_firstSamplePos = 0;			// The absolute position of m_samples[0]
+	std::vector<KeyType> m_samples;			// In ascending order
+	size_type m_nLaidOut = 0;				// The number of samples in the Eytzinger layout, the rest forming the tail
+
+	// 1-based Eytzinger layout of m_samples[0, m_nLaidOut), and the index in m_samples of each of its elements
+	std::vector<KeyType> m_eytzinger;
+	std::vector<std::uint32_t> m_ranks;
+	Compare m_compare;
+
+	size_type SamplePos(size_type j) const
+	{
+		return m_firstSamplePos + j * SAMPLE_STRIDE;
+	}
+
+	size_type NumStaleSamples() const
+	{
+		return (m_frontPos > m_firstSamplePos) ? std::min((m_frontPos - m_firstSamplePos) / SAMPLE_STRIDE, m_samples.size()) : 0;
+	}
+
+	// The number of samples which are less than k
+	size_type SampleLowerBound(const KeyType& k) const
+	{
+		if ((m_nLaidOut > 0) && ! m_compare(m_samples[m_nLaidOut - 1], k)) {
+			return EytzingerLowerBound(k);
+		}
+
+		return std::lower_bound(m_samples.begin() + m_nLaidOut, m_samples.end(), k, m_compare) - m_samples.begin();
+	}
+
+	size_type EytzingerLowerBound(const KeyType& k) const
+	{
+		const KeyType* const eytzinger = m_eytzinger.data();
+		constexpr size_type PREFETCH_STRIDE = size_type(1) << PREFETCH_LEVELS;
+		size_type i = 1;
+		while (i <= m_nLaidOut) {
+			if (PREFETCH_STRIDE * i < m_eytzinger.size()) {
+				SearchIndexDetail::Prefetch(eytzinger + PREFETCH_STRIDE * i);
+			}
+
+			i = 2 * i + (m_compare(eytzinger[i], k) ? 1 : 0);
+		}
+
+		// Undo the right turns taken after the last left turn, which led to the lower bound
+		while (i & 1) {
+			i >>= 1;
+		}
+
+		i >>= 1;
+		return (0 == i) ? m_nLaidOut : m_ranks[i];
+	}
+
+	void LayOut()
+	{
+		m_nLaidOut = m_samples.size();
+		m_eytzinger.resize(m_nLaidOut + 1);
+		m_ranks.resize(m_nLaidOut + 1);
+		LayOut(1, 0);
+	}
+
+	size_type LayOut(size_type i, size_type rank)
+	{
+		if (i <= m_nLaidOut) {
+			rank = LayOut(2 * i, rank);
+			m_eytzinger[i] = m_samples[rank];
+			m_ranks[i] = static_cast<std::uint32_t>(rank);
+			rank = LayOut(2 * i + 1, rank + 1);
+		}
+
+		return rank;
+	}
+};
+
+// PiecewiseLinearSearchIndex: A learned index for arithmetic keys, which models the mapping from keys to positions
+// as a sequence of linear segments, each predicting the position of any of its keys to within MAX_ERROR positions.
+// Segments are built incrementally as values are appended, using the shrinking cone algorithm: a segment keeps the range
+// of slopes from its first point which satisfy the error bound for all its points, and a new segment is started once an
+// appended point cannot be accommodated. Hence keys which arrive in bursts at different rates take a segment per burst.
+// A search locates the segment by a binary search over the segments, and narrows the search over the values to a window
+// of 2 * MAX_ERROR + 2 positions around the predicted one. It requires the keys to be in ascending order.
+// Positions are absolute, so that removing values from the front only advances the position of the front.
+
+template <typename KeyType, std::size_t MAX_ERROR = 16>
+class PiecewiseLinearSearchIndex {
+	static_assert(std::is_arithmetic<KeyType>::value, "PiecewiseLinearSearchIndex requires arithmetic keys");
+
+public:
+	typedef std::size_t size_type;
+
+	template <typename Keys>
+	void OnPushBack(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY(keys.size() != m_nKnownSize + 1)) {
+			OnReset(keys);
+			return;
+		}
+
+		Append(keys[keys.size() - 1]);
+	}
+
+	template <typename Keys>
+	void OnPushFront(const Keys& keys)
+	{
+		OnReset(keys);
+	}
+
+	template <typename Keys>
+	void OnPopFront(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_frontPos += n;
+		m_nKnownSize -= n;
+		size_type nStale = 0;
+		while ((nStale < m_segments.size()) && (m_segments[nStale].m_lastPos < m_frontPos)) {
+			++nStale;
+		}
+
+		m_segments.erase(m_segments.begin(), m_segments.begin() + nStale);
+	}
+
+	template <typename Keys>
+	void OnPopBack(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_nKnownSize -= n;
+		const size_type endPos = EndPos();
+		while (! m_segments.empty() && (m_segments.back().m_firstPos >= endPos)) {
+			m_segments.pop_back();
+		}
+
+		// The slope range of the last segment remains valid for the remaining points, if somewhat narrower than necessary
+		if (! m_segments.empty() && (m_segments.back().m_lastPos >= endPos)) {
+			m_segments.back().m_lastPos = endPos - 1;
+			m_segments.back().m_lastKey = keys[endPos - 1 - m_frontPos];
+		}
+	}
+
+	template <typename Keys>
+	void OnReset(const Keys& keys)
+	{
+		m_frontPos = 0;
+		m_nKnownSize = 0;
+		m_segments.clear();
+		for (size_type i = 0; i < keys.size(); ++i) {
+			Append(keys[i]);
+		}
+	}
+
+	template <typename Keys, typename SizeType>
+	constexpr SearchIndexLookup Lookup(const Keys&, const KeyType&, SizeType&) const
+	{
+		return SEARCH_INDEX_UNKNOWN;
+	}
+
+	template <typename Keys, typename SizeType>
+	bool Narrow(const Keys& keys, const KeyType& k, SizeType& lo, SizeType& hi) const
+	{
+		if (BOOST_UNLIKELY((keys.size() != m_nKnownSize) || m_segments.empty())) {
+			return false;
+		}
+
+		const auto segIt = std::upper_bound(m_segments.begin(), m_segments.end(), k,
+											[](const KeyType& k, const Segment& seg)->bool { return k < seg.m_firstKey; });
+		if (segIt == m_segments.begin()) {
+			lo = hi = 0;
+			return true;
+		}
+
+		const Segment& seg = *(segIt - 1);
+		size_type loPos, hiPos;
+		if (seg.m_lastKey < k) {
+			loPos = hiPos = seg.m_lastPos + 1;
+		}
+		else {
+			const double predicted = static_cast<double>(seg.m_firstPos) + seg.Slope() * static_cast<double>(k - seg.m_firstKey);
+			const double error = static_cast<double>(MAX_ERROR + 1);
+			loPos = std::max(seg.m_firstPos, static_cast<size_type>(std::max(predicted - error, 0.0)));
+			hiPos = std::min(seg.m_lastPos + 1, static_cast<size_type>(std::max(predicted + error + 1, 0.0)));
+		}
+
+		loPos = std::max(loPos, m_frontPos);
+		hiPos = std::max(hiPos, loPos);
+		lo = loPos - m_frontPos;
+		hi = hiPos - m_frontPos;
+		return true;
+	}
+
+	size_type segment_count() const
+	{
+		return m_segments.size();
+	}
+
+private:
+	struct Segment {
+		KeyType m_firstKey;
+		size_type m_firstPos;
+		KeyType m_lastKey;
+		size_type m_lastPos;
+		double m_minSlope;
+		double m_maxSlope;
+
+		double Slope() const
+		{
+			// A segment with a single point has an unbounded maximal slope, but only predicts its own key
+			return (m_lastPos == m_firstPos) ? 0.0 : (m_minSlope + m_maxSlope) / 2;
+		}
+	};
+
+	size_type m_frontPos = 0;				// The absolute position of the front
+	size_type m_nKnownSize = 0;				// The size of the deque as last notified
+	std::vector<Segment> m_segments;
+
+	size_type EndPos() const
+	{
+		return m_frontPos + m_nKnownSize;
+	}
+
+	void Append(const KeyType& k)
+	{
+		const size_type pos = EndPos();
+		++m_nKnownSize;
+		if (! m_segments.empty()) {
+			Segment& seg = m_segments.back();
+			const double dx = static_cast<double>(k - seg.m_firstKey);
+			const double dy = static_cast<double>(pos - seg.m_firstPos);
+			const double minSlope = std::max(seg.m_minSlope, (dy - MAX_ERROR) / dx);
+			const double maxSlope = std::min(seg.m_maxSlope, (dy + MAX_ERROR) / dx);
+			if (minSlope <= maxSlope) {
+				seg.m_minSlope = minSlope;
+				seg.m_maxSlope = maxSlope;
+				seg.m_lastKey = k;
+				seg.m_lastPos = pos;
+				return;
+			}
+		}
+
+		m_segments.push_back(Segment{ k, pos, k, pos, 0.0, std::numeric_limits<double>::infinity() });
+	}
+};
+
+// HashSearchIndex: An open addressing hash table mapping each key to its absolute position, for keys which have no
+// arithmetic structure to exploit, such as wide integers or strings. An exact lookup takes a single probe sequence
+// and a single comparison of keys in the deque, so that find() and erase() by key take constant time, hits and misses alike.
+// Entries are never removed individually: removing values from either edge leaves stale entries behind, which a lookup
+// rejects by comparing the key at the recorded position, and the table is rebuilt once the stale entries outnumber the
+// values. Positions are absolute, so that removing values from the front only advances the position of the front.
+// Searches for keys which are not present fall back to the search policy over the whole range.
+// Costs about (sizeof(KeyType) + sizeof(size_t)) * 2-4 bytes per value, for a load factor between 1/4 and 1/2.
+
+template <typename KeyType, typename Hash = std::hash<KeyType>>
+class HashSearchIndex {
+public:
+	typedef std::size_t size_type;
+
+	template <typename Keys>
+	void OnPushBack(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY(keys.size() != m_nKnownSize + 1)) {
+			OnReset(keys);
+			return;
+		}
+
+		++m_nKnownSize;
+		Insert(keys[keys.size() - 1], m_frontPos + keys.size() - 1);
+	}
+
+	template <typename Keys>
+	void OnPushFront(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY((keys.size() != m_nKnownSize + 1) || (0 == m_frontPos))) {
+			OnReset(keys);
+			return;
+		}
+
+		++m_nKnownSize;
+		--m_frontPos;
+		Insert(keys[0], m_frontPos);
+	}
+
+	template <typename Keys>
+	void OnPopFront(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_frontPos += n;
+		m_nKnownSize -= n;
+		m_nStale += n;
+		if (m_nStale > std::max<size_type>(m_nKnownSize, MIN_CAPACITY)) {
+			OnReset(keys);
+		}
+	}
+
+	template <typename Keys>
+	void OnPopBack(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_nKnownSize -= n;
+		m_nStale += n;
+		if (m_nStale > std::max<size_type>(m_nKnownSize, MIN_CAPACITY)) {
+			OnReset(keys);
+		}
+	}
+
+	template <typename Keys>
+	void OnReset(const Keys& keys)
+	{
+		// Leave room in front, so that values prepended after a reset don't trigger another one
+		m_frontPos = keys.size() + MIN_CAPACITY;
+		m_nKnownSize = keys.size();
+		m_nStale = 0;
+		m_nEntries = 0;
+		size_type capacity = MIN_CAPACITY;
+		while (capacity < 4 * m_nKnownSize) {
+			capacity *= 2;
+		}
+
+		m_slots.assign(capacity, Slot());
+		UpdateShift();
+		for (size_type i = 0; i < m_nKnownSize; ++i) {
+			Insert(keys[i], m_frontPos + i);
+		}
+	}
+
+	template <typename Keys, typename SizeType>
+	bool Narrow(const Keys& keys, const KeyType& k, SizeType& lo, SizeType& hi) const
+	{
+		SizeType pos = 0;
+		if (SEARCH_INDEX_FOUND == Lookup(keys, k, pos)) {
+			lo = pos;
+			hi = pos + 1;
+			return true;
+		}
+
+		return false;
+	}
+
+	template <typename Keys, typename SizeType>
+	SearchIndexLookup Lookup(const Keys& keys, const KeyType& k, SizeType& pos) const
+	{
+		if (BOOST_UNLIKELY((keys.size() != m_nKnownSize) || m_slots.empty())) {
+			return SEARCH_INDEX_UNKNOWN;
+		}
+
+		const Slot* const slot = FindSlot(k);
+		if ((EMPTY_POS == slot->m_pos) || (slot->m_pos < m_frontPos) || (slot->m_pos - m_frontPos >= m_nKnownSize)) {
+			return SEARCH_INDEX_ABSENT;
+		}
+
+		// The entry may be stale, having been left behind by a value which was since replaced by another
+		const size_type index = slot->m_pos - m_frontPos;
+		if (! (keys[index] == k)) {
+			return SEARCH_INDEX_ABSENT;
+		}
+
+		pos = static_cast<SizeType>(index);
+		return SEARCH_INDEX_FOUND;
+	}
+
+	size_type capacity() const
+	{
+		return m_slots.size();
+	}
+
+private:
+	enum { MIN_CAPACITY = 16 };
+	static constexpr size_type EMPTY_POS = std::numeric_limits<size_type>::max();
+
+	struct Slot {
+		KeyType m_key;
+		size_type m_pos = EMPTY_POS;
+	};
+
+	size_type m_frontPos = 0;				// The absolute position of the front
+	size_type m_nKnownSize = 0;				// The size of the deque as last notified
+	size_type m_nStale = 0;					// An upper bound on the number of entries for removed values
+	size_type m_nEntries = 0;
+	unsigned m_shift = 64;					// 64 - log2(m_slots.size())
+	std::vector<Slot> m_slots;				// A power of two in size, with linear probing
+
+	// The slot holding k, or the empty slot at which it would be inserted
+	const Slot* FindSlot(const KeyType& k) const
+	{
+		// Fibonacci hashing spreads the bits of hash functions which are the identity, as std::hash commonly is for integers
+		const size_type mask = m_slots.size() - 1;
+		size_type i = static_cast<size_type>((static_cast<std::uint64_t>(Hash()(k)) * 0x9E3779B97F4A7C15ull) >> m_shift) & mask;
+		while ((EMPTY_POS != m_slots[i].m_pos) && ! (m_slots[i].m_key == k)) {
+			i = (i + 1) & mask;
+		}
+
+		return & m_slots[i];
+	}
+
+	void Insert(const KeyType& k, size_type pos)
+	{
+		if (BOOST_UNLIKELY(2 * (m_nEntries + 1) > m_slots.size())) {
+			Grow();
+		}
+
+		Slot* const slot = const_cast<Slot*>(FindSlot(k));
+		if (EMPTY_POS == slot->m_pos) {
+			slot->m_key = k;
+			++m_nEntries;
+		}
+
+		slot->m_pos = pos;
+	}
+
+	void UpdateShift()
+	{
+		m_shift = 64;
+		for (size_type c = m_slots.size(); c > 1; c >>= 1) {
+			--m_shift;
+		}
+	}
+
+	void Grow()
+	{
+		std::vector<Slot> oldSlots(std::max<size_type>(2 * m_slots.size(), MIN_CAPACITY));
+		oldSlots.swap(m_slots);
+		UpdateShift();
+		m_nEntries = 0;
+		for (const Slot& slot : oldSlots) {
+			if (EMPTY_POS != slot.m_pos) {
+				Insert(slot.m_key, slot.m_pos);
+			}
+		}
+	}
+};
+
+// StringKeyPrefix: Maps a string-like key, supplying data() and size(), to its first 8 bytes in big-endian order,
+// padded with zeros, so that comparing the prefixes as integers agrees with comparing the strings byte by byte.
+
+struct StringKeyPrefix {
+	template <typename StringType>
+	std::uint64_t operator() (const StringType& s) const
+	{
+		const std::size_t n = std::min<std::size_t>(s.size(), sizeof(std::uint64_t));
+		const unsigned char* const bytes = reinterpret_cast<const unsigned char*>(s.data());
+		std::uint64_t prefix = 0;
+		for (std::size_t i = 0; i < sizeof(std::uint64_t); ++i) {
+			prefix = (prefix << 8) | ((i < n) ? bytes[i] : 0);
+		}
+
+		return prefix;
+	}
+};
+
+// PrefixSearchIndex: Mirrors a fixed-size integer prefix of the key of every value in a contiguous array, so that
+// searches over keys which are costly to compare, such as strings or tuples, proceed by integer comparisons.
+// A search narrows the range of positions to those whose prefix equals that of the searched key, where the full keys are
+// compared, and a key whose prefix does not occur at all is known to be absent without examining any value.
+// PrefixOf must map keys to integers in an order-preserving manner: if a < b then PrefixOf()(a) <= PrefixOf()(b),
+// which requires the keys to be in ascending order. Keys sharing long common prefixes degrade to a plain search.
+// Positions are absolute, so that removing values from the front only advances the position of the front.
+
+template <typename KeyType, typename PrefixOf = StringKeyPrefix, typename PrefixType = std::uint64_t>
+class PrefixSearchIndex {
+public:
+	typedef std::size_t size_type;
+
+	template <typename Keys>
+	void OnPushBack(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY(keys.size() != KnownSize() + 1)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_prefixes.push_back(PrefixOf()(keys[keys.size() - 1]));
+	}
+
+	template <typename Keys>
+	void OnPushFront(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY((keys.size() != KnownSize() + 1) || (0 == m_front))) {
+			OnReset(keys);
+			return;
+		}
+
+		--m_front;
+		m_prefixes[m_front] = PrefixOf()(keys[0]);
+	}
+
+	template <typename Keys>
+	void OnPopFront(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != KnownSize())) {
+			OnReset(keys);
+			return;
+		}
+
+		m_front += n;
+
+		// Reclaim the space in front once it's the majority, keeping the amortized cost of removal constant
+		if (m_front > m_prefixes.size() / 2) {
+			m_prefixes.erase(m_prefixes.begin(), m_prefixes.begin() + m_front);
+			m_front = 0;
+		}
+	}
+
+	template <typename Keys>
+	void OnPopBack(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != KnownSize())) {
+			OnReset(keys);
+			return;
+		}
+
+		m_prefixes.resize(m_prefixes.size() - n);
+	}
+
+	template <typename Keys>
+	void OnReset(const Keys& keys)
+	{
+		m_front = 0;
+		m_prefixes.resize(keys.size());
+		for (size_type i = 0; i < keys.size(); ++i) {
+			m_prefixes[i] = PrefixOf()(keys[i]);
+		}
+	}
+
+	template <typename Keys, typename SizeType>
+	bool Narrow(const Keys& keys, const KeyType& k, SizeType& lo, SizeType& hi) const
+	{
+		if (BOOST_UNLIKELY(keys.size() != KnownSize())) {
+			return false;
+		}
+
+		// Since the prefixes preserve the order, the lower bound of k is within or just after the positions sharing its prefix
+		const auto range = std::equal_range(m_prefixes.begin() + m_front, m_prefixes.end(), PrefixOf()(k));
+		lo = range.first - (m_prefixes.begin() + m_front);
+		hi = range.second - (m_prefixes.begin() + m_front);
+		return true;
+	}
+
+	template <typename Keys, typename SizeType>
+	SearchIndexLookup Lookup(const Keys& keys, const KeyType& k, SizeType& pos) const
+	{
+		SizeType lo = 0;
+		SizeType hi = 0;
+		if (! Narrow(keys, k, lo, hi)) {
+			return SEARCH_INDEX_UNKNOWN;
+		}
+
+		if (lo == hi) {
+			return SEARCH_INDEX_ABSENT;
+		}
+
+		// Only a key sharing the prefix of k may be equal to it
+		if (hi - lo == 1) {
+			if (keys[lo] == k) {
+				pos = lo;
+				return SEARCH_INDEX_FOUND;
+			}
+
+			return SEARCH_INDEX_ABSENT;
+		}
+
+		return SEARCH_INDEX_UNKNOWN;
+	}
+
+private:
+	size_type m_front = 0;					// The index in m_prefixes of the prefix of the front value
+	std::vector<PrefixType> m_prefixes;
+
+	size_type KnownSize() const
+	{
+		return m_prefixes.size() - m_front;
+	}
+};
+
+// DeltaSearchIndex: A compressed mirror of all the keys, for large containers of integral keys which are closely spaced.
+// The keys are stored in blocks of up to BLOCK_SIZE keys, each holding its first key as a base and the differences of the
+// others from it as DeltaType, so that the mirror takes about sizeof(DeltaType) bytes per value, and is more likely to
+// fit in the cache than the values or the keys. A block is ended early when a key is too far from its base to fit.
+// A search selects the block by a binary search over the bases, and then counts the deltas in the block which are less
+// than that of the searched key, in a loop of fixed length which the compiler vectorizes. This yields the exact lower bound,
+// and tells whether the key is present, without accessing the values. It requires the keys to be in ascending order.
+// Positions are absolute, so that removing values from the front only advances the position of the front.
+
+template <typename KeyType, std::size_t BLOCK_SIZE = 64, typename DeltaType = std::uint16_t>
+class DeltaSearchIndex {
+	static_assert(std::is_integral<KeyType>::value, "DeltaSearchIndex requires integral keys");
+	static_assert(std::is_unsigned<DeltaType>::value, "DeltaSearchIndex requires unsigned deltas");
+
+public:
+	typedef std::size_t size_type;
+
+	template <typename Keys>
+	void OnPushBack(const Keys& keys)
+	{
+		if (BOOST_UNLIKELY(keys.size() != m_nKnownSize + 1)) {
+			OnReset(keys);
+			return;
+		}
+
+		Append(keys[keys.size() - 1]);
+	}
+
+	template <typename Keys>
+	void OnPushFront(const Keys& keys)
+	{
+		OnReset(keys);
+	}
+
+	template <typename Keys>
+	void OnPopFront(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_frontPos += n;
+		m_nKnownSize -= n;
+		size_type nStale = 0;
+		while ((nStale < m_bases.size()) && (BlockEndPos(nStale) <= m_frontPos)) {
+			++nStale;
+		}
+
+		if (nStale > 0) {
+			m_bases.erase(m_bases.begin(), m_bases.begin() + nStale);
+			m_firstPositions.erase(m_firstPositions.begin(), m_firstPositions.begin() + nStale);
+			m_deltas.erase(m_deltas.begin(), m_deltas.begin() + nStale * BLOCK_SIZE);
+		}
+	}
+
+	template <typename Keys>
+	void OnPopBack(const Keys& keys, size_type n)
+	{
+		if (BOOST_UNLIKELY(keys.size() + n != m_nKnownSize)) {
+			OnReset(keys);
+			return;
+		}
+
+		m_nKnownSize -= n;
+		const size_type endPos = EndPos();
+		while (! m_bases.empty() && (m_firstPositions.back() >= endPos)) {
+			m_bases.pop_back();
+			m_firstPositions.pop_back();
+			m_deltas.resize(m_deltas.size() - BLOCK_SIZE);
+		}
+
+		// Pad the removed part of the last block, so that it isn't counted by searches
+		if (! m_bases.empty()) {
+			const size_type nLast = endPos - m_firstPositions.back();
+			std::fill(m_deltas.end() - (BLOCK_SIZE - nLast), m_deltas.end(), PADDING);
+		}
+	}
+
+	template <typename Keys>
+	void OnReset(const Keys& keys)
+	{
+		m_frontPos = 0;
+		m_nKnownSize = 0;
+		m_bases.clear();
+		m_firstPositions.clear();
+		m_deltas.clear();
+		for (size_type i = 0; i < keys.size(); ++i) {
+			Append(keys[i]);
+		}
+	}
+
+	template <typename Keys, typename SizeType>
+	bool Narrow(const Keys& keys, const KeyType& k, SizeType& lo, SizeType& hi) const
+	{
+		if (BOOST_UNLIKELY((keys.size() != m_nKnownSize) || m_bases.empty())) {
+			return false;
+		}
+
+		lo = hi = static_cast<SizeType>(LowerBound(k).first - m_frontPos);
+		return true;
+	}
+
+	template <typename Keys, typename SizeType>
+	SearchIndexLookup Lookup(const Keys& keys, const KeyType& k, SizeType& pos) const
+	{
+		if (BOOST_UNLIKELY((keys.size() != m_nKnownSize) || m_bases.empty())) {
+			return SEARCH_INDEX_UNKNOWN;
+		}
+
+		const std::pair<size_type, bool> result = LowerBound(k);
+		if (! result.second) {
+			return SEARCH_INDEX_ABSENT;
+		}
+
+		pos = static_cast<SizeType>(result.first - m_frontPos);
+		return SEARCH_INDEX_FOUND;
+	}
+
+	// The number of bytes used by the mirrored keys
+	size_type memory_usage() const
+	{
+		return m_bases.size() * (sizeof(KeyType) + sizeof(size_type)) + m_deltas.size() * sizeof(DeltaType);
+	}
+
+private:
+	static constexpr DeltaType PADDING = std::numeric_limits<DeltaType>::max();
+	typedef typename std::make_unsigned<KeyType>::type UnsignedKey;
+
+	size_type m_frontPos = 0;				// The absolute position of the front
+	size_type m_nKnownSize = 0;				// The size of the deque as last notified
+	std::vector<KeyType> m_bases;			// The first key of each block
+	std::vector<size_type> m_firstPositions;	// The absolute position of the first key of each block
+	std::vector<DeltaType> m_deltas;		// BLOCK_SIZE differences from the base per block, padded with PADDING
+
+	size_type EndPos() const
+	{
+		return m_frontPos + m_nKnownSize;
+	}
+
+	size_type BlockEndPos(size_type block) const
+	{
+		return (block + 1 < m_bases.size()) ? m_firstPositions[block + 1] : EndPos();
+	}
+
+	void Append(const KeyType& k)
+	{
+		const size_type pos = EndPos();
+		++m_nKnownSize;
+		if (! m_bases.empty()) {
+			const size_type nLast = pos - m_firstPositions.back();
+			const UnsignedKey delta = static_cast<UnsignedKey>(k) - static_cast<UnsignedKey>(m_bases.back());
+			if ((nLast < BLOCK_SIZE) && (delta < PADDING)) {
+				m_deltas[m_deltas.size() - BLOCK_SIZE + nLast] = static_cast<DeltaType>(delta);
+				return;
+			}
+		}
+
+		m_bases.push_back(k);
+		m_firstPositions.push_back(pos);
+		m_deltas.resize(m_deltas.size() + BLOCK_SIZE, PADDING);
+		m_deltas[m_deltas.size() - BLOCK_SIZE] = 0;
+	}
+
+	// The absolute position of the lower bound of k, and whether the key there equals k
+	std::pair<size_type, bool> LowerBound(const KeyType& k) const
+	{
+		const auto baseIt = std::upper_bound(m_bases.begin(), m_bases.end(), k);
+		if (baseIt == m_bases.begin()) {
+			return std::make_pair(m_frontPos, false);
+		}
+
+		const size_type block = (baseIt - m_bases.begin()) - 1;
+		const UnsignedKey delta = static_cast<UnsignedKey>(k) - static_cast<UnsignedKey>(m_bases[block]);
+		const size_type blockSize = BlockEndPos(block) - m_firstPositions[block];
+		size_type nLess = blockSize;
+		if (delta < PADDING) {
+			const DeltaType d = static_cast<DeltaType>(delta);
+			const DeltaType* const deltas = m_deltas.data() + block * BLOCK_SIZE;
+			nLess = 0;
+			for (size_type i = 0; i < BLOCK_SIZE; ++i) {
+				nLess += (deltas[i] < d) ? 1 : 0;
+			}
+		}
+
+		// Keys removed from the front remain in the first block, and are less than any key which is present
+		const size_type pos = m_firstPositions[block] + nLess;
+		if (pos < m_frontPos) {
+			return std::make_pair(m_frontPos, false);
+		}
+
+		const bool bFound = (nLess < blockSize) && (delta < PADDING) && (m_deltas[block * BLOCK_SIZE + nLess] == delta);
+		return std::make_pair(pos, bFound);
+	}
+};
+
+// Defined for C++14, where PADDING is odr-used by binding it to the references taken by std::fill() and resize().
+// Since C++17 static constexpr members are implicitly inline, and the definition is deprecated.
+#if __cplusplus < 201703L
+template <typename KeyType, std::size_t BLOCK_SIZE, typename DeltaType>
+constexpr DeltaType DeltaSearchIndex<KeyType, BLOCK_SIZE, DeltaType>::PADDING;
+#endif
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUESEARCHINDEXES_H_ */
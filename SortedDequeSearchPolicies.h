@@ -0,0 +1,148 @@
+/*
+ * SortedDequeSearchPolicies.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUESEARCHPOLICIES_H_
+#define UTILS_SORTEDDEQUESEARCHPOLICIES_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+
+#include "IntrusiveSortedDeque.h"
+
+// Search policies which may be used as the SearchPolicy template argument of InstrusiveSortedDeque.
+// See BinarySearchPolicy in IntrusiveSortedDeque.h for the interface which they implement.
+
+namespace Utils {
+
+// InterpolationSearchPolicy: For arithmetic keys which are close to uniformly spaced. Each step estimates the position
+// of the key by linear interpolation between the keys at the edges of the remaining range, and then probes a guard
+// position about sqrt(n) values further in the direction of the key. If the key lies between the two probes, the range
+// shrinks to the distance between them, giving O(log(log(n))) probes on uniform keys. Each time it does not, this is
+// counted as a miss, and after MAX_MISSES misses the search continues as a binary search, bounding the worst case.
+// Ranges shorter than MIN_INTERPOLATED_SIZE, which must be at least 3, are always binary searched. Non-arithmetic keys,
+// and keys ordered by anything other than std::less, use a binary search.
+
+template <unsigned MAX_MISSES = 2, std::size_t MIN_INTERPOLATED_SIZE = 16>
+struct InterpolationSearchPolicy {
+	// A probe at the last position of a range of 2 values may not shrink it, so the search would never end
+	static_assert(MIN_INTERPOLATED_SIZE >= 3, "Ranges of fewer than 3 values should be binary searched");
+
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter LowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		return DoLowerBound(first, last, k, keyOf, comp, std::integral_constant<bool,
+							std::is_arithmetic<KeyType>::value && IsAscending<Compare, KeyType>::value>());
+	}
+
+private:
+	template <typename Compare, typename KeyType>
+	struct IsAscending : std::integral_constant<bool, std::is_same<Compare, std::less<KeyType>>::value ||
+													  std::is_same<Compare, std::less<>>::value> {};
+
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter DoLowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp, std::false_type)
+	{
+		return BinarySearchPolicy::LowerBound(first, last, k, keyOf, comp);
+	}
+
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static Iter DoLowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp, std::true_type)
+	{
+		typedef typename std::iterator_traits<Iter>::difference_type Distance;
+		unsigned nMisses = 0;
+		for (Distance len = last - first; (len >= Distance(MIN_INTERPOLATED_SIZE)) && (nMisses < MAX_MISSES); len = last - first) {
+			const KeyType loKey = keyOf(*first);
+			if (! (loKey < k)) {
+				return first;
+			}
+
+			const KeyType hiKey = keyOf(*(last - 1));
+			if (hiKey < k) {
+				return last;
+			}
+
+			// Now loKey < k <= hiKey, and the lower bound is in (first, last - 1]
+			const double fraction = (static_cast<double>(k) - static_cast<double>(loKey)) /
+									(static_cast<double>(hiKey) - static_cast<double>(loKey));
+			const Distance estimate = std::min(std::max(Distance(fraction * (len - 1)), Distance(1)), len - 1);
+			const Distance guard = std::max(Distance(std::sqrt(static_cast<double>(len))), Distance(1));
+			const Iter probe = first + estimate;
+			if (keyOf(*probe) < k) {
+				// The lower bound is in (probe, last - 1]
+				first = probe + 1;
+				if (last - first > guard) {
+					const Iter guardProbe = first + guard;
+					if (keyOf(*guardProbe) < k) {
+						first = guardProbe + 1;
+						++nMisses;
+					}
+					else {
+						last = guardProbe + 1;
+					}
+				}
+			}
+			else {
+				// The lower bound is in (first, probe]
+				last = probe + 1;
+				if (probe - first > guard) {
+					const Iter guardProbe = probe - guard;
+					if (keyOf(*guardProbe) < k) {
+						first = guardProbe + 1;
+					}
+					else {
+						last = guardProbe + 1;
+						++nMisses;
+					}
+				}
+			}
+		}
+
+		return BinarySearchPolicy::LowerBound(first, last, k, keyOf, comp);
+	}
+};
+
+// BranchlessSearchPolicy: A binary search in which the choice of the half to continue with is made by a conditional move
+// rather than by a branch, so that its cost does not depend on branch prediction, which mostly fails on random lookups.
+// Once the range is no longer than LINEAR_SEARCH_THRESHOLD, the lower bound is found by counting the keys which are less
+// than the searched key, which also avoids branches, and makes a single sequential pass over adjacent values.
+
+template <std::size_t LINEAR_SEARCH_THRESHOLD = 4>
+struct BranchlessSearchPolicy {
+	static_assert(LINEAR_SEARCH_THRESHOLD >= 1, "The linear search must cover at least one value");
+
+	template <typename Iter, typename KeyType, typename KeyOf, typename Compare>
+	static inline Iter LowerBound(Iter first, Iter last, const KeyType& k, KeyOf keyOf, Compare comp)
+	{
+		typedef typename std::iterator_traits<Iter>::difference_type Distance;
+
+		// The lower bound is in [first + base, first + base + len]. Only the offset is selected conditionally, since
+		// moving a deque iterator involves a branch of its own.
+		Distance base = 0;
+		Distance len = last - first;
+		while (len > Distance(LINEAR_SEARCH_THRESHOLD)) {
+			const Distance half = len / 2;
+			base = comp(keyOf(first[base + half - 1]), k) ? base + half : base;
+			len -= half;
+		}
+
+		const Iter scanBegin = first + base;
+		Distance nLess = 0;
+		for (Distance i = 0; i < len; ++i) {
+			nLess += comp(keyOf(scanBegin[i]), k) ? 1 : 0;
+		}
+
+		return scanBegin + nLess;
+	}
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUESEARCHPOLICIES_H_ */
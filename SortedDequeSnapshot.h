@@ -0,0 +1,248 @@
+/*
+ * SortedDequeSnapshot.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUESNAPSHOT_H_
+#define UTILS_SORTEDDEQUESNAPSHOT_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include <boost/iterator/iterator_facade.hpp>
+
+namespace Utils {
+
+// SortedDequeSnapshot: An immutable copy of the live values of an InstrusiveSortedDeque as of some version.
+// The values are held in reference-counted segments, which are shared with later snapshots for as long as the
+// corresponding values remain unchanged. A segment is freed once the last snapshot referring to it is released.
+
+template <typename T>
+class SortedDequeSnapshot {
+public:
+	typedef typename T::KeyType key_type;
+	typedef T value_type;
+	typedef const T& const_reference;
+	typedef std::size_t size_type;
+	typedef std::uint64_t version_type;
+
+private:
+	typedef std::vector<T> Block;
+
+	// A sub-range of a shared block
+	struct Segment {
+		std::shared_ptr<const Block> m_pBlock;
+		size_type m_offset;
+		size_type m_count;
+
+		const T& First() const { return (*m_pBlock)[m_offset]; }
+		const T& Last() const { return (*m_pBlock)[m_offset + m_count - 1]; }
+	};
+
+	enum { BLOCK_SIZE = 256 };
+
+	// The number of values which Build() copies between checks of whether the source range is still valid
+	enum { VALIDATE_INTERVAL = 64 };
+
+public:
+	class const_iterator : public boost::iterator_facade<const_iterator, const T, std::forward_iterator_tag> {
+		friend class SortedDequeSnapshot;
+		friend class boost::iterator_core_access;
+
+		const Segment* m_pSegment = nullptr;
+		size_type m_index = 0;
+
+		const_iterator(const Segment* pSegment, size_type index)
+			: m_pSegment(pSegment)
+			, m_index(index)
+		{
+		}
+
+		const T& dereference() const { return (*m_pSegment->m_pBlock)[m_pSegment->m_offset + m_index]; }
+		bool equal(const const_iterator& other) const { return (m_pSegment == other.m_pSegment) && (m_index == other.m_index); }
+
+		void increment()
+		{
+			if (++m_index == m_pSegment->m_count) {
+				++m_pSegment;
+				m_index = 0;
+			}
+		}
+
+	public:
+		const_iterator() = default;
+	};
+
+	version_type version() const { return m_version; }
+	size_type size() const { return m_size; }
+	bool empty() const { return 0 == m_size; }
+
+	const_iterator begin() const { return const_iterator(m_segments.data(), 0); }
+	const_iterator end() const { return const_iterator(m_segments.data() + m_segments.size(), 0); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	const_reference front() const { return m_segments.front().First(); }
+	const_reference back() const { return m_segments.back().Last(); }
+
+	// Returns an iterator to the first value whose key is not less than k
+	const_iterator lower_bound(key_type k) const
+	{
+		const auto segIt = std::lower_bound(m_segments.begin(), m_segments.end(), k,
+											[](const Segment& seg, key_type k)->bool { return seg.Last().GetKey() < k; });
+		if (segIt == m_segments.end()) {
+			return end();
+		}
+
+		const auto first = segIt->m_pBlock->begin() + segIt->m_offset;
+		const auto it = std::lower_bound(first, first + segIt->m_count, k,
+										 [](const T& value, key_type k)->bool { return value.GetKey() < k; });
+		return const_iterator(&*segIt, it - first);
+	}
+
+	const_iterator find(key_type k) const
+	{
+		const const_iterator it = lower_bound(k);
+		return ((it != end()) && (it->GetKey() == k)) ? it : end();
+	}
+
+	// Builds a snapshot from the raw range [first, last] of an InstrusiveSortedDeque, which may contain deleted values.
+	// Segments of the previous snapshot, if given, are reused wherever isChanged(firstKey, lastKey) indicates that no value
+	// with a key in the closed range has been inserted or removed since the previous snapshot was taken.
+	// The range may be modified while it's copied, in which case isValid() returns false, and the copy stops early, leaving
+	// a partial snapshot which should be discarded. The iterators are only moved by position, within the size which the
+	// range had to begin with, since they aren't reliably compared with last while the range is modified.
+	template <typename RawIter, typename ChangedPred, typename ValidPred>
+	static std::shared_ptr<const SortedDequeSnapshot> Build(RawIter first, RawIter last, version_type version,
+															const SortedDequeSnapshot* pPrevious, ChangedPred&& isChanged,
+															ValidPred&& isValid)
+	{
+		auto pResult = std::make_shared<SortedDequeSnapshot>(version);
+		SegmentBuilder builder(*pResult);
+		const size_type n = last - first;
+		size_type pos = 0;
+		RawIter it = first;
+
+		// Copies the values from it onwards for as long as pred holds, checking isValid() every VALIDATE_INTERVAL values
+		const auto appendWhile = [&](auto&& pred)->bool {
+			for (; (pos < n) && pred(*it); ++pos, ++it) {
+				if ((0 == pos % VALIDATE_INTERVAL) && ! isValid()) {
+					return false;
+				}
+
+				builder.Append(*it);
+			}
+
+			return true;
+		};
+
+		if (nullptr != pPrevious) {
+			for (const Segment& seg : pPrevious->m_segments) {
+				if (pos == n) {
+					break;
+				}
+
+				if (! isValid()) {
+					return pResult;
+				}
+
+				// Skip the values which have been removed from the front
+				const key_type frontKey = it->GetKey();
+				if (seg.Last().GetKey() < frontKey) {
+					continue;
+				}
+
+				const auto segBegin = seg.m_pBlock->begin() + seg.m_offset;
+				const auto segEnd = segBegin + seg.m_count;
+				const auto liveBegin = std::lower_bound(segBegin, segEnd, frontKey,
+														[](const T& value, key_type k)->bool { return value.GetKey() < k; });
+				const key_type firstKey = liveBegin->GetKey();
+				const key_type lastKey = seg.Last().GetKey();
+				if (! appendWhile([firstKey](const T& value) { return value.GetKey() < firstKey; })) {
+					return pResult;
+				}
+
+				if (isChanged(firstKey, lastKey)) {
+					continue;
+				}
+
+				builder.Share(Segment{ seg.m_pBlock, size_type(liveBegin - seg.m_pBlock->begin()), size_type(segEnd - liveBegin) });
+				it = std::upper_bound(it, last, lastKey, [](key_type k, const T& value)->bool { return k < value.GetKey(); });
+				pos = it - first;
+			}
+		}
+
+		if (! appendWhile([](const T&) { return true; })) {
+			return pResult;
+		}
+
+		builder.Flush();
+		return pResult;
+	}
+
+	explicit SortedDequeSnapshot(version_type version)
+		: m_version(version)
+	{
+	}
+
+private:
+	std::vector<Segment> m_segments;
+	size_type m_size = 0;
+	version_type m_version;
+
+	// Accumulates newly copied values into blocks, interleaved with shared segments
+	class SegmentBuilder {
+		SortedDequeSnapshot& m_snapshot;
+		std::shared_ptr<Block> m_pCurrent;
+
+	public:
+		explicit SegmentBuilder(SortedDequeSnapshot& snapshot)
+			: m_snapshot(snapshot)
+		{
+		}
+
+		void Append(const T& value)
+		{
+			if (value.IsDeleted()) {
+				return;
+			}
+
+			if (! m_pCurrent) {
+				m_pCurrent = std::make_shared<Block>();
+				m_pCurrent->reserve(BLOCK_SIZE);
+			}
+
+			m_pCurrent->push_back(value);
+			if (m_pCurrent->size() == BLOCK_SIZE) {
+				Flush();
+			}
+		}
+
+		void Share(Segment&& segment)
+		{
+			Flush();
+			m_snapshot.m_size += segment.m_count;
+			m_snapshot.m_segments.push_back(std::move(segment));
+		}
+
+		void Flush()
+		{
+			if (m_pCurrent) {
+				const size_type count = m_pCurrent->size();
+				m_snapshot.m_size += count;
+				m_snapshot.m_segments.push_back(Segment{ std::move(m_pCurrent), 0, count });
+				m_pCurrent.reset();
+			}
+		}
+	};
+};
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUESNAPSHOT_H_ */
@@ -0,0 +1,402 @@
+/*
+ * SortedDequeTombstones.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: yitzikc
+ */
+
+#ifndef UTILS_SORTEDDEQUETOMBSTONES_H_
+#define UTILS_SORTEDDEQUETOMBSTONES_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "IntrusiveSortedDeque.h"
+
+// Tombstones policies which may be used as the Tombstones template argument of InstrusiveSortedDeque.
+// See IntrusiveTombstones in IntrusiveSortedDeque.h for the interface which they implement.
+
+namespace Utils {
+
+namespace TombstonesDetail {
+
+inline unsigned CountTrailingZeros(std::uint64_t word)
+{
+	assert(word != 0);
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	unsigned n = 0;
+	while (! (word & 1)) {
+		word >>= 1;
+		++n;
+	}
+
+	return n;
+#endif
+}
+
+inline unsigned CountLeadingZeros(std::uint64_t word)
+{
+	assert(word != 0);
+#if defined(__GNUC__)
+	return __builtin_clzll(word);
+#else
+	unsigned n = 0;
+	while (! (word >> 63)) {
+		word <<= 1;
+		++n;
+	}
+
+	return n;
+#endif
+}
+
+inline unsigned PopCount(std::uint64_t word)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	unsigned n = 0;
+	for (; word != 0; word &= word - 1) {
+		++n;
+	}
+
+	return n;
+#endif
+}
+
+}	// namespace TombstonesDetail
+
+// BitmapTombstones: Tracks the deleted values in a bitmap owned by the container, with a set bit for each deleted value,
+// so that the values need not have a deleted flag, nor IsDeleted() and Remove() methods.
+// Runs of deleted values are skipped a word at a time, by counting the trailing or leading zeros of the inverted words.
+// The bitmap starts at a bit offset within its first word, so that values can be pushed and popped at the front
+// while only shifting the words once every 64 values. The words are only allocated once a value is removed.
+// All the bits outside the range of positions of the values are kept clear.
+
+class BitmapTombstones {
+public:
+	typedef std::size_t size_type;
+
+	template <typename T>
+	bool IsDeleted(const T&, size_type pos) const
+	{
+		const size_type bit = m_offset + pos;
+		return (bit / WORD_BITS < m_words.size()) && ((m_words[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1);
+	}
+
+	template <typename T>
+	void Remove(T&, size_type pos)
+	{
+		const size_type bit = m_offset + pos;
+		if (bit / WORD_BITS >= m_words.size()) {
+			m_words.resize(bit / WORD_BITS + 1, 0);
+		}
+
+		m_words[bit / WORD_BITS] |= Word(1) << (bit % WORD_BITS);
+	}
+
+	// Values which aren't held by the container have no tombstones
+	template <typename T>
+	static constexpr bool IsDeletedValue(const T&) { return false; }
+
+	// The bits of the positions following the values are clear, so the search stops at end at the latest
+	template <typename Iter>
+	Iter SkipForward(Iter it, Iter end, size_type& pos) const
+	{
+		const size_type first = m_offset + pos;
+		size_type w = first / WORD_BITS;
+		if (w >= m_words.size()) {
+			return it;
+		}
+
+		Word live = ~m_words[w] & (ALL_BITS << (first % WORD_BITS));
+		while ((live == 0) && (++w < m_words.size())) {
+			live = ~m_words[w];
+		}
+
+		const size_type bit = (live != 0) ? (w * WORD_BITS + TombstonesDetail::CountTrailingZeros(live)) : (w * WORD_BITS);
+		if (bit == first) {
+			return it;
+		}
+
+		assert(static_cast<std::ptrdiff_t>(bit - first) <= end - it);
+		pos += bit - first;
+		return it + (bit - first);
+	}
+
+	template <typename Iter>
+	Iter SkipBackward(Iter it, size_type& pos) const
+	{
+		const size_type last = m_offset + pos;
+		size_type w = last / WORD_BITS;
+		if (w >= m_words.size()) {
+			return it;
+		}
+
+		// The front value is never deleted, so this stops at its word at the latest
+		Word live = ~m_words[w] & (ALL_BITS >> (WORD_BITS - 1 - last % WORD_BITS));
+		while (live == 0) {
+			assert(w > 0);
+			live = ~m_words[--w];
+		}
+
+		const size_type bit = w * WORD_BITS + WORD_BITS - 1 - TombstonesDetail::CountLeadingZeros(live);
+		pos -= last - bit;
+		return it - (last - bit);
+	}
+
+	// Counts the set bits a word at a time
+	template <typename Iter>
+	size_type CountDeleted(Iter, size_type pos, size_type n) const
+	{
+		size_type first = m_offset + pos;
+		const size_type last = std::min<size_type>(first + n, m_words.size() * WORD_BITS);
+		size_type count = 0;
+		while (first < last) {
+			const size_type wordEnd = std::min<size_type>(last, (first / WORD_BITS + 1) * WORD_BITS);
+			count += TombstonesDetail::PopCount(m_words[first / WORD_BITS] & WordMask(first, wordEnd));
+			first = wordEnd;
+		}
+
+		return count;
+	}
+
+	template <typename T>
+	std::uint64_t LiveMask(const T*, size_type pos, size_type n) const
+	{
+		assert((n > 0) && (n <= WORD_BITS));
+		const size_type first = m_offset + pos;
+		const size_type w = first / WORD_BITS;
+		const unsigned b = first % WORD_BITS;
+		Word deleted = 0;
+		if (w < m_words.size()) {
+			deleted = m_words[w] >> b;
+			if ((b > 0) && (w + 1 < m_words.size())) {
+				deleted |= m_words[w + 1] << (WORD_BITS - b);
+			}
+		}
+
+		const Word inRange = (n == WORD_BITS) ? ALL_BITS : ((Word(1) << n) - 1);
+		return ~deleted & inRange;
+	}
+
+	void OnPushBack(size_type)
+	{
+	}
+
+	void OnPushFront(size_type)
+	{
+		if (m_words.empty()) {
+			m_offset = 0;
+			return;
+		}
+
+		if (m_offset == 0) {
+			m_words.insert(m_words.begin(), 0);
+			m_offset = WORD_BITS;
+		}
+
+		--m_offset;
+	}
+
+	void OnPopFront(size_type size, size_type n)
+	{
+		if (size == 0) {
+			OnReset(0);
+			return;
+		}
+
+		ClearBits(m_offset, m_offset + n);
+		m_offset += n;
+		const size_type nWords = std::min(m_offset / WORD_BITS, m_words.size());
+		if (nWords > 0) {
+			m_words.erase(m_words.begin(), m_words.begin() + nWords);
+			m_offset -= nWords * WORD_BITS;
+		}
+	}
+
+	void OnPopBack(size_type size, size_type n)
+	{
+		ClearBits(m_offset + size, m_offset + size + n);
+	}
+
+	// Shift the bits of the values following pos, which have moved up by one position
+	void OnInsert(size_type size, size_type pos)
+	{
+		const size_type first = m_offset + pos;
+		if (first / WORD_BITS >= m_words.size()) {
+			return;
+		}
+
+		const size_type lastWord = (m_offset + size - 1) / WORD_BITS;
+		if (lastWord >= m_words.size()) {
+			m_words.resize(lastWord + 1, 0);
+		}
+
+		for (size_type w = lastWord; w > first / WORD_BITS; --w) {
+			m_words[w] = (m_words[w] << 1) | (m_words[w - 1] >> (WORD_BITS - 1));
+		}
+
+		Word& word = m_words[first / WORD_BITS];
+		const unsigned b = first % WORD_BITS;
+		const Word lowMask = (Word(1) << b) - 1;
+		const Word highMask = (b == WORD_BITS - 1) ? 0 : (ALL_BITS << (b + 1));
+		word = (word & lowMask) | ((word << 1) & highMask);
+	}
+
+	void OnReset(size_type)
+	{
+		m_words.clear();
+		m_offset = 0;
+	}
+
+	// The number of deleted values
+	size_type count() const
+	{
+		size_type n = 0;
+		for (Word word : m_words) {
+			n += TombstonesDetail::PopCount(word);
+		}
+
+		return n;
+	}
+
+private:
+	typedef std::uint64_t Word;
+	static constexpr unsigned WORD_BITS = 64;
+	static constexpr Word ALL_BITS = ~Word(0);
+
+	std::vector<Word> m_words;
+	size_type m_offset = 0;	// The bit of the front value
+
+	// The mask of the bits [first, last) within the word holding bit first, where last is at most the end of that word
+	static Word WordMask(size_type first, size_type last)
+	{
+		const unsigned nBits = last - first;
+		return (nBits == WORD_BITS) ? ALL_BITS : (((Word(1) << nBits) - 1) << (first % WORD_BITS));
+	}
+
+	// Clear the bits in the range [first, last)
+	void ClearBits(size_type first, size_type last)
+	{
+		last = std::min<size_type>(last, m_words.size() * WORD_BITS);
+		for (; first < last; first = (first / WORD_BITS + 1) * WORD_BITS) {
+			const size_type wordEnd = std::min<size_type>(last, (first / WORD_BITS + 1) * WORD_BITS);
+			m_words[first / WORD_BITS] &= ~WordMask(first, wordEnd);
+		}
+	}
+};
+
+// PackedKeyTombstones: Marks a value as deleted by setting a reserved bit of its unsigned integral key, DELETED_BIT,
+// which is the most significant bit by default, so that the values need no separate deleted flag.
+// The key is accessed through Field, which is IdentityKeyOf for values which are plain integers, or MemberKeyOf.
+// It serves both as the Tombstones policy and as the KeyOf key extractor, which masks DELETED_BIT out of the keys,
+// so both template arguments should be set to it. Hence checking whether a value is deleted uses the same load as
+// comparing its key. The keys of the values inserted must not have DELETED_BIT set.
+
+template <typename Field, typename Key, Key DELETED_BIT = Key(1) << (std::numeric_limits<Key>::digits - 1)>
+class PackedKeyTombstones {
+	static_assert(std::is_unsigned<Key>::value, "The packed keys should be of an unsigned integral type");
+	static_assert((DELETED_BIT != 0) && ((DELETED_BIT & (DELETED_BIT - 1)) == 0), "DELETED_BIT should have a single bit set");
+
+public:
+	typedef std::size_t size_type;
+
+	template <typename T>
+	using key_type = Key;
+
+	template <typename T>
+	Key operator()(const T& value) const
+	{
+		return Field()(value) & ~DELETED_BIT;
+	}
+
+	template <typename T>
+	static bool IsDeleted(const T& value, size_type)
+	{
+		return IsDeletedValue(value);
+	}
+
+	template <typename T>
+	static void Remove(T& value, size_type)
+	{
+		Field()(value) |= DELETED_BIT;
+	}
+
+	template <typename T>
+	static bool IsDeletedValue(const T& value)
+	{
+		return (Field()(value) & DELETED_BIT) != 0;
+	}
+
+	template <typename Iter>
+	static Iter SkipForward(Iter it, Iter end, size_type& pos)
+	{
+		while ((it != end) && IsDeletedValue(*it)) {
+			++it;
+			++pos;
+		}
+
+		return it;
+	}
+
+	template <typename Iter>
+	static Iter SkipBackward(Iter it, size_type& pos)
+	{
+		while (IsDeletedValue(*it)) {
+			--it;
+			--pos;
+		}
+
+		return it;
+	}
+
+	template <typename Iter>
+	static size_type CountDeleted(Iter it, size_type, size_type n)
+	{
+		size_type count = 0;
+		for (; n > 0; --n, ++it) {
+			count += IsDeletedValue(*it);
+		}
+
+		return count;
+	}
+
+	template <typename T>
+	static std::uint64_t LiveMask(const T* values, size_type, size_type n)
+	{
+		std::uint64_t mask = 0;
+		for (size_type i = 0; i < n; ++i) {
+			mask |= std::uint64_t(! IsDeletedValue(values[i])) << i;
+		}
+
+		return mask;
+	}
+
+	void OnPushBack(size_type) {}
+	void OnPushFront(size_type) {}
+	void OnPopFront(size_type, size_type) {}
+	void OnPopBack(size_type, size_type) {}
+	void OnInsert(size_type, size_type) {}
+	void OnReset(size_type) {}
+};
+
+// SortedValueDeque: An InstrusiveSortedDeque of values which are their own keys, such as plain integers,
+// with their tombstones kept in a bitmap, so that the values need not supply any types or methods.
+
+template <typename T, typename Allocator = std::allocator<T>, typename SearchIndex = NoSearchIndex, typename SearchPolicy = BinarySearchPolicy,
+		  typename Compare = std::less<T>>
+using SortedValueDeque = InstrusiveSortedDeque<T, Allocator, SearchIndex, SearchPolicy, Compare, BitmapTombstones, IdentityKeyOf>;
+
+}	// namespace Utils
+
+#endif /* UTILS_SORTEDDEQUETOMBSTONES_H_ */